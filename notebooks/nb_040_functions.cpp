@@ -455,4 +455,2502 @@ std::cout << ">>> 2 <<<\n";
 estimator.add_data(4, 6);
 std::cout << estimator << "\n";
 
+// %% [markdown] slideshow={"slide_type": "slide"}
+// ## Functions at Scale
+//
+// The examples above are written for clarity. The following sections show how the same functions can be adapted when they have to process millions of records, without giving up the rules for clean functions.
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Tracing Without Cost
+//
+// - The pay calculations above write "Calculating pay for ..." to `std::cout` every time
+// - Useful for debugging, but far too expensive for a payroll run over millions of employees
+// - Better: trace events with a level
+//   - Events above the *compile-time* level are removed completely by `if constexpr`
+//   - Events above the *runtime* level cost one comparison
+//   - Every thread records into its own buffer without locking
+//   - The events are written out after the run
+//   - When a thread ends, its buffer is passed on to the next thread that starts tracing
+// - We keep the `std::cout` output of `calculate_commissioned_pay()` and the other functions above, since the slides show it
+//   - Only the pay calculations for many employees that follow (`EmployeeStore` and the `*EmployeeRecord` types) use `trace()`
+//   - The `AbstractEmployee` subclasses, including those handed out by the `EmployeeRoster` below, still print on every call
+
+// %%
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+// %%
+#ifndef PAY_TRACE_LEVEL
+#define PAY_TRACE_LEVEL 1
+#endif
+
+// %%
+enum class TraceLevel { off, info, debug };
+
+// %%
+constexpr TraceLevel compiled_trace_level{static_cast<TraceLevel>(PAY_TRACE_LEVEL)};
+
+// %%
+std::atomic<TraceLevel> runtime_trace_level{TraceLevel::info};
+
+// %% slideshow={"slide_type": "subslide"}
+struct TraceEvent {
+    std::chrono::steady_clock::time_point time{};
+    std::size_t thread_index{};
+    const char* message{};
+    long value{};
+};
+
+// %%
+// Written only by the thread that currently owns it; `num_recorded` publishes the events to the thread that
+// dumps them.
+class TraceBuffer {
+public:
+    static constexpr std::size_t capacity{1 << 16};
+
+    void record(std::size_t thread_index, const char* message, long value) {
+        const auto index = num_recorded.load(std::memory_order_relaxed);
+        if (index == capacity) {
+            num_dropped.store(num_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        events[index] = TraceEvent{std::chrono::steady_clock::now(), thread_index, message, value};
+        num_recorded.store(index + 1, std::memory_order_release);
+    }
+
+    template <typename EventFun>
+    void for_each_event(EventFun process_event) const {
+        const auto num_events = num_recorded.load(std::memory_order_acquire);
+        for (std::size_t i{0}; i < num_events; ++i) {
+            process_event(events[i]);
+        }
+    }
+
+    std::size_t get_num_dropped() const { return num_dropped.load(std::memory_order_relaxed); }
+
+    // Only while no thread records into this buffer.
+    void clear() {
+        num_recorded.store(0, std::memory_order_relaxed);
+        num_dropped.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<TraceEvent[]> events{std::make_unique<TraceEvent[]>(capacity)};
+    std::atomic<std::size_t> num_recorded{0};
+    std::atomic<std::size_t> num_dropped{0};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+// Keeps the buffers alive, so that they can be dumped after their threads have finished. A buffer whose thread
+// has finished is reused by the next thread, so there are never more buffers than threads tracing at the same time.
+class TraceRegistry {
+public:
+    TraceBuffer& acquire_buffer() {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (!free_buffers.empty()) {
+            auto& buffer = *free_buffers.back();
+            free_buffers.pop_back();
+            return buffer;
+        }
+        buffers.push_back(std::make_unique<TraceBuffer>());
+        return *buffers.back();
+    }
+
+    void release_buffer(TraceBuffer& buffer) {
+        std::lock_guard<std::mutex> lock{mutex};
+        free_buffers.push_back(&buffer);
+    }
+
+    std::size_t register_thread() { return num_threads.fetch_add(1, std::memory_order_relaxed); }
+
+    template <typename EventFun>
+    void for_each_event(EventFun process_event) const {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (const auto& buffer : buffers) {
+            buffer->for_each_event(process_event);
+        }
+    }
+
+    std::size_t get_num_dropped() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        return std::accumulate(cbegin(buffers), cend(buffers), std::size_t{0},
+                               [](std::size_t sum, const auto& buffer) { return sum + buffer->get_num_dropped(); });
+    }
+
+    // Only while no thread is tracing.
+    void clear() {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto& buffer : buffers) {
+            buffer->clear();
+        }
+    }
+
+private:
+    mutable std::mutex mutex{};
+    std::vector<std::unique_ptr<TraceBuffer>> buffers{};
+    std::vector<TraceBuffer*> free_buffers{};
+    std::atomic<std::size_t> num_threads{0};
+};
+
+// %%
+TraceRegistry trace_registry{};
+
+// %%
+// Holds the trace buffer of the current thread and returns it to the registry when the thread ends.
+class ThreadTraceBuffer {
+public:
+    ThreadTraceBuffer() : thread_index{trace_registry.register_thread()}, buffer{trace_registry.acquire_buffer()} {}
+    ThreadTraceBuffer(const ThreadTraceBuffer&) = delete;
+    ThreadTraceBuffer& operator=(const ThreadTraceBuffer&) = delete;
+    ~ThreadTraceBuffer() { trace_registry.release_buffer(buffer); }
+
+    void record(const char* message, long value) { buffer.record(thread_index, message, value); }
+
+private:
+    std::size_t thread_index;
+    TraceBuffer& buffer;
+};
+
+// %%
+ThreadTraceBuffer& get_thread_trace_buffer() {
+    thread_local ThreadTraceBuffer buffer{};
+    return buffer;
+}
+
+// %% slideshow={"slide_type": "subslide"}
+template <TraceLevel level>
+void trace(const char* message, long value = 0) {
+    if constexpr (level != TraceLevel::off && level <= compiled_trace_level) {
+        if (level <= runtime_trace_level.load(std::memory_order_relaxed)) {
+            get_thread_trace_buffer().record(message, value);
+        }
+    }
+}
+
+// %%
+// Writes the events of all threads in the order in which they were recorded and discards them. Must only be
+// called while no thread is tracing, e.g., after a run.
+void dump_trace_events(std::ostream& os) {
+    std::vector<TraceEvent> events{};
+    trace_registry.for_each_event([&events](const TraceEvent& event) { events.push_back(event); });
+    std::stable_sort(begin(events), end(events), [](const auto& lhs, const auto& rhs) { return lhs.time < rhs.time; });
+    for (const auto& event : events) {
+        os << "[thread " << event.thread_index << "] " << event.message << " (" << event.value << ")\n";
+    }
+    os << trace_registry.get_num_dropped() << " events dropped\n";
+    trace_registry.clear();
+}
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// The pay calculations below record their progress with `trace()`. With the default compile-time level `info`, the `debug` events for individual employees do not exist in the compiled code. If `PAY_TRACE_LEVEL` is defined as `0`, all tracing is removed and the pay calculation compiles to exactly the same code as without any tracing. (The events for individual employees deliberately record no value: evaluating an argument that is not needed may already change the generated code.)
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Partitioning Employees by Type
+//
+// - `calculate_pay()` dispatches on the type tag of every employee
+// - `AbstractEmployee::calculate_pay()` dispatches through a virtual call
+// - Both process one record at a time and follow a pointer or branch for each
+// - If we keep each type of employee in its own contiguous arrays, we can compute the pay for a whole partition in one tight loop
+
+// %%
+long compute_commissioned_pay_in_cents(long base_pay_in_cents, long sales_in_cents,
+                                       long commission_rate_in_basis_points) {
+    return base_pay_in_cents + (sales_in_cents * commission_rate_in_basis_points + 5'000) / 10'000;
+}
+
+// %%
+long compute_hourly_pay_in_cents(long hours_worked, long hourly_rate_in_cents) {
+    return hours_worked * hourly_rate_in_cents;
+}
+
+// %%
+long compute_salaried_pay_in_cents(long salary_in_cents) {
+    return salary_in_cents;
+}
+
+// %% slideshow={"slide_type": "subslide"}
+struct CommissionedEmployees {
+    std::vector<long> base_pay_in_cents{};
+    std::vector<long> sales_in_cents{};
+    std::vector<long> commission_rates_in_basis_points{};
+};
+
+// %%
+struct HourlyEmployees {
+    std::vector<long> hours_worked{};
+    std::vector<long> hourly_rates_in_cents{};
+};
+
+// %%
+struct SalariedEmployees {
+    std::vector<long> salaries_in_cents{};
+};
+
+// %%
+struct EmployeeHandle {
+    EmployeeType type{};
+    std::size_t index{};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+class EmployeeStore {
+public:
+    EmployeeHandle add_commissioned_employee(Money base_pay, Money sales, long commission_rate_in_basis_points) {
+        commissioned.base_pay_in_cents.push_back(base_pay.amount_in_cents);
+        commissioned.sales_in_cents.push_back(sales.amount_in_cents);
+        commissioned.commission_rates_in_basis_points.push_back(commission_rate_in_basis_points);
+        return {EmployeeType::commissioned, commissioned.base_pay_in_cents.size() - 1};
+    }
+
+    EmployeeHandle add_hourly_employee(long hours_worked, Money hourly_rate) {
+        hourly.hours_worked.push_back(hours_worked);
+        hourly.hourly_rates_in_cents.push_back(hourly_rate.amount_in_cents);
+        return {EmployeeType::hourly, hourly.hours_worked.size() - 1};
+    }
+
+    EmployeeHandle add_salaried_employee(Money salary) {
+        salaried.salaries_in_cents.push_back(salary.amount_in_cents);
+        return {EmployeeType::salaried, salaried.salaries_in_cents.size() - 1};
+    }
+
+    std::size_t size() const {
+        return commissioned.base_pay_in_cents.size() + hourly.hours_worked.size()
+               + salaried.salaries_in_cents.size();
+    }
+
+    std::vector<Money> calculate_commissioned_pay() const {
+        const auto num_employees = commissioned.base_pay_in_cents.size();
+        trace<TraceLevel::info>("Calculating pay for commissioned employees.", static_cast<long>(num_employees));
+        std::vector<Money> pay(num_employees);
+        for (std::size_t i{0}; i < num_employees; ++i) {
+            pay[i].amount_in_cents = compute_commissioned_pay_in_cents(
+                commissioned.base_pay_in_cents[i], commissioned.sales_in_cents[i],
+                commissioned.commission_rates_in_basis_points[i]);
+        }
+        return pay;
+    }
+
+    std::vector<Money> calculate_hourly_pay() const {
+        const auto num_employees = hourly.hours_worked.size();
+        trace<TraceLevel::info>("Calculating pay for hourly employees.", static_cast<long>(num_employees));
+        std::vector<Money> pay(num_employees);
+        for (std::size_t i{0}; i < num_employees; ++i) {
+            pay[i].amount_in_cents =
+                compute_hourly_pay_in_cents(hourly.hours_worked[i], hourly.hourly_rates_in_cents[i]);
+        }
+        return pay;
+    }
+
+    std::vector<Money> calculate_salaried_pay() const {
+        const auto num_employees = salaried.salaries_in_cents.size();
+        trace<TraceLevel::info>("Calculating pay for salaried employees.", static_cast<long>(num_employees));
+        std::vector<Money> pay(num_employees);
+        for (std::size_t i{0}; i < num_employees; ++i) {
+            pay[i].amount_in_cents = compute_salaried_pay_in_cents(salaried.salaries_in_cents[i]);
+        }
+        return pay;
+    }
+
+    Money calculate_pay(EmployeeHandle employee) const {
+        const auto i = employee.index;
+        switch (employee.type) {
+            case EmployeeType::commissioned:
+                return Money{compute_commissioned_pay_in_cents(commissioned.base_pay_in_cents[i],
+                                                               commissioned.sales_in_cents[i],
+                                                               commissioned.commission_rates_in_basis_points[i])};
+            case EmployeeType::hourly:
+                return Money{compute_hourly_pay_in_cents(hourly.hours_worked[i], hourly.hourly_rates_in_cents[i])};
+            case EmployeeType::salaried:
+                return Money{compute_salaried_pay_in_cents(salaried.salaries_in_cents[i])};
+        }
+        return Money{};
+    }
+
+private:
+    CommissionedEmployees commissioned{};
+    HourlyEmployees hourly{};
+    SalariedEmployees salaried{};
+};
+
+// %%
+Money calculate_total_pay(const std::vector<Money>& pay) {
+    return std::accumulate(cbegin(pay), cend(pay), Money{},
+                           [](Money total, Money m) { return Money{total.amount_in_cents + m.amount_in_cents}; });
+}
+
+// %% slideshow={"slide_type": "subslide"}
+EmployeeStore employee_store{};
+employee_store.add_commissioned_employee(Money{200'000}, Money{1'500'000}, 500);
+employee_store.add_hourly_employee(160, Money{2'500});
+auto an_employee_handle = employee_store.add_salaried_employee(Money{450'000});
+
+// %%
+std::cout << "Commissioned: " << calculate_total_pay(employee_store.calculate_commissioned_pay()).amount_in_cents
+          << " cents\n";
+std::cout << "Hourly:       " << calculate_total_pay(employee_store.calculate_hourly_pay()).amount_in_cents
+          << " cents\n";
+std::cout << "Salaried:     " << calculate_total_pay(employee_store.calculate_salaried_pay()).amount_in_cents
+          << " cents\n";
+
+// %%
+employee_store.calculate_pay(an_employee_handle).amount_in_cents
+
+// %%
+dump_trace_events(std::cout);
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Switch, Virtual Function or Variant?
+//
+// - We argued that the `switch` in `calculate_pay()` should be replaced by virtual functions
+// - If the set of employee types is closed, `std::variant` is a third option
+//   - The objects are stored by value, without an allocation per employee
+//   - `std::visit` dispatches statically to the right `calculate_pay()`
+// - But which one is fastest? We have to measure!
+
+// %%
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <type_traits>
+#include <variant>
+
+// %% slideshow={"slide_type": "subslide"}
+struct CommissionedEmployeeRecord {
+    long base_pay_in_cents{};
+    long sales_in_cents{};
+    long commission_rate_in_basis_points{};
+
+    Money calculate_pay() const {
+        trace<TraceLevel::debug>("Calculating pay for commissioned employee.");
+        return Money{compute_commissioned_pay_in_cents(base_pay_in_cents, sales_in_cents,
+                                                       commission_rate_in_basis_points)};
+    }
+};
+
+// %%
+struct HourlyEmployeeRecord {
+    long hours_worked{};
+    long hourly_rate_in_cents{};
+
+    Money calculate_pay() const {
+        trace<TraceLevel::debug>("Calculating pay for hourly employee.");
+        return Money{compute_hourly_pay_in_cents(hours_worked, hourly_rate_in_cents)};
+    }
+};
+
+// %%
+struct SalariedEmployeeRecord {
+    long salary_in_cents{};
+
+    Money calculate_pay() const {
+        trace<TraceLevel::debug>("Calculating pay for salaried employee.");
+        return Money{compute_salaried_pay_in_cents(salary_in_cents)};
+    }
+};
+
+// %% slideshow={"slide_type": "subslide"}
+// The closed set of employee types, dispatched statically
+using EmployeeRecord = std::variant<CommissionedEmployeeRecord, HourlyEmployeeRecord, SalariedEmployeeRecord>;
+
+// %%
+Money calculate_pay(const EmployeeRecord& employee) {
+    return std::visit([](const auto& concrete_employee) { return concrete_employee.calculate_pay(); }, employee);
+}
+
+// %%
+calculate_pay(EmployeeRecord{HourlyEmployeeRecord{160, 2'500}}).amount_in_cents
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// For the comparison we need the same employees with a type tag and as subclasses of an abstract base class:
+
+// %%
+// Each constructor sets the tag together with the union member it starts.
+struct TaggedEmployeeRecord {
+    explicit TaggedEmployeeRecord(const CommissionedEmployeeRecord& record)
+        : type{EmployeeType::commissioned}, commissioned{record} {}
+    explicit TaggedEmployeeRecord(const HourlyEmployeeRecord& record) : type{EmployeeType::hourly}, hourly{record} {}
+    explicit TaggedEmployeeRecord(const SalariedEmployeeRecord& record)
+        : type{EmployeeType::salaried}, salaried{record} {}
+
+    EmployeeType type;
+    union {
+        CommissionedEmployeeRecord commissioned;
+        HourlyEmployeeRecord hourly;
+        SalariedEmployeeRecord salaried;
+    };
+};
+
+// %%
+Money calculate_pay(const TaggedEmployeeRecord& employee) {
+    switch (employee.type) {
+        case EmployeeType::commissioned:
+            return employee.commissioned.calculate_pay();
+        case EmployeeType::hourly:
+            return employee.hourly.calculate_pay();
+        case EmployeeType::salaried:
+            return employee.salaried.calculate_pay();
+    }
+    return Money{};
+}
+
+// %%
+struct AbstractEmployeeRecord {
+    virtual ~AbstractEmployeeRecord() = default;
+    virtual Money calculate_pay() const = 0;
+};
+
+// %%
+template <typename Record>
+struct PolymorphicEmployeeRecord : public AbstractEmployeeRecord {
+    explicit PolymorphicEmployeeRecord(Record record) : record{record} {}
+
+    Money calculate_pay() const override { return record.calculate_pay(); }
+
+    Record record;
+};
+
+// %%
+Money calculate_pay(const std::unique_ptr<AbstractEmployeeRecord>& employee) {
+    return employee->calculate_pay();
+}
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// The benchmark creates the same employees in all three representations, either sorted by type or in random order, and measures the time per call of `calculate_pay()`.
+//
+// (The interpreter does not optimize as aggressively as the compiler, and the largest sizes need a lot of time and memory. The cell below stops at 100,000 employees; to get realistic numbers, compile the benchmark with optimizations and call `benchmark_pay_dispatch()` with its default of 10,000,000 employees.)
+
+// %%
+std::vector<EmployeeType> create_employee_types(std::size_t num_employees, bool is_shuffled) {
+    std::vector<EmployeeType> types(num_employees);
+    for (std::size_t i{0}; i < num_employees; ++i) {
+        types[i] = static_cast<EmployeeType>(i * 3 / num_employees);
+    }
+    if (is_shuffled) {
+        std::shuffle(begin(types), end(types), std::mt19937{42});
+    }
+    return types;
+}
+
+// %%
+EmployeeRecord create_employee_record(EmployeeType type, std::size_t i) {
+    const long variation{static_cast<long>(i % 100)};
+    switch (type) {
+        case EmployeeType::commissioned:
+            return CommissionedEmployeeRecord{200'000 + variation, 1'000'000 + 1'000 * variation, 500};
+        case EmployeeType::hourly:
+            return HourlyEmployeeRecord{120 + variation, 2'500};
+        case EmployeeType::salaried:
+            return SalariedEmployeeRecord{400'000 + 100 * variation};
+    }
+    return EmployeeRecord{};
+}
+
+// %%
+TaggedEmployeeRecord to_tagged_employee_record(const EmployeeRecord& employee) {
+    return std::visit([](const auto& concrete_employee) { return TaggedEmployeeRecord{concrete_employee}; }, employee);
+}
+
+// %%
+std::unique_ptr<AbstractEmployeeRecord> to_polymorphic_employee_record(const EmployeeRecord& employee) {
+    return std::visit([](const auto& concrete_employee) -> std::unique_ptr<AbstractEmployeeRecord> {
+        using Record = std::decay_t<decltype(concrete_employee)>;
+        return std::make_unique<PolymorphicEmployeeRecord<Record>>(concrete_employee);
+    }, employee);
+}
+
+// %% slideshow={"slide_type": "subslide"}
+template <typename Employees>
+double measure_nanoseconds_per_employee(const Employees& employees) {
+    const std::size_t num_repetitions{std::max<std::size_t>(1, 10'000'000 / employees.size())};
+    long total_pay_in_cents{0};
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t repetition{0}; repetition < num_repetitions; ++repetition) {
+        for (const auto& employee : employees) {
+            total_pay_in_cents += calculate_pay(employee).amount_in_cents;
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    // Storing the total in a `volatile` keeps the compiler from discarding the calculations we want to time.
+    [[maybe_unused]] static volatile long timed_total_pay_in_cents{};
+    timed_total_pay_in_cents = total_pay_in_cents;
+    return std::chrono::duration<double, std::nano>(end - start).count() / (num_repetitions * employees.size());
+}
+
+// %%
+template <typename Employee, typename ConvertFun>
+double measure_nanoseconds_per_employee(const std::vector<EmployeeRecord>& records, ConvertFun convert) {
+    std::vector<Employee> employees{};
+    employees.reserve(records.size());
+    std::transform(cbegin(records), cend(records), std::back_inserter(employees), convert);
+    return measure_nanoseconds_per_employee(employees);
+}
+
+// %% slideshow={"slide_type": "subslide"}
+void benchmark_pay_dispatch(std::size_t max_num_employees = 10'000'000) {
+    std::cout << "employees  order      switch   virtual   variant  (ns/employee)\n";
+    for (std::size_t num_employees{1'000}; num_employees <= max_num_employees; num_employees *= 10) {
+        for (bool is_shuffled : {false, true}) {
+            const auto types = create_employee_types(num_employees, is_shuffled);
+            std::vector<EmployeeRecord> records{};
+            records.reserve(num_employees);
+            for (std::size_t i{0}; i < num_employees; ++i) {
+                records.push_back(create_employee_record(types[i], i));
+            }
+            const auto switch_ns = measure_nanoseconds_per_employee<TaggedEmployeeRecord>(
+                records, to_tagged_employee_record);
+            const auto virtual_ns = measure_nanoseconds_per_employee<std::unique_ptr<AbstractEmployeeRecord>>(
+                records, to_polymorphic_employee_record);
+            const auto variant_ns = measure_nanoseconds_per_employee(records);
+            std::printf("%9zu  %-8s %8.2f  %8.2f  %8.2f\n", num_employees, is_shuffled ? "shuffled" : "sorted",
+                        switch_ns, virtual_ns, variant_ns);
+        }
+    }
+}
+
+// %%
+benchmark_pay_dispatch(100'000);
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Creating Many Employees
+//
+// - `create_employee()` calls `std::make_unique()` for every employee
+// - For a roster of millions of employees most of the time is spent in the memory allocator
+// - The objects end up scattered all over the heap
+// - An `EmployeeRoster` instead places the employees in pools, one for each concrete type
+//   - Each pool allocates memory in large blocks
+//   - The roster owns all employees; they are released together when the roster is destroyed
+//   - It creates the same classes as `create_employee()`, so `calculate_pay()` still prints to `std::cout`; it speeds up creating employees, not paying them
+
+// %%
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// %% slideshow={"slide_type": "subslide"}
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(std::size_t objects_per_block = 4096) : objects_per_block{objects_per_block} {}
+
+    ~ObjectPool() {
+        // Trivially destructible objects need no destructor call, so releasing the pool only frees the blocks.
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (std::size_t i{0}; i < size(); ++i) {
+                get_object(i)->~T();
+            }
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (blocks.empty() || size_in_last_block == objects_per_block) {
+            blocks.push_back(std::unique_ptr<Slot[]>{new Slot[objects_per_block]});
+            size_in_last_block = 0;
+        }
+        T* object{new (&blocks.back()[size_in_last_block]) T(std::forward<Args>(args)...)};
+        ++size_in_last_block;
+        return object;
+    }
+
+    std::size_t size() const {
+        return blocks.empty() ? 0 : (blocks.size() - 1) * objects_per_block + size_in_last_block;
+    }
+
+private:
+    struct alignas(T) Slot {
+        std::byte storage[sizeof(T)];
+    };
+
+    T* get_object(std::size_t index) {
+        return std::launder(reinterpret_cast<T*>(&blocks[index / objects_per_block][index % objects_per_block]));
+    }
+
+    std::size_t objects_per_block;
+    std::vector<std::unique_ptr<Slot[]>> blocks{};
+    std::size_t size_in_last_block{0};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+// The employees created by the roster are owned by the roster and live as long as it does.
+class EmployeeRoster {
+public:
+    AbstractEmployee* create_employee(EmployeeType type) {
+        switch (type) {
+            case EmployeeType::commissioned:
+                return commissioned_employees.create();
+            case EmployeeType::hourly:
+                return hourly_employees.create();
+            case EmployeeType::salaried:
+                return salaried_employees.create();
+        }
+        return nullptr;
+    }
+
+    std::size_t size() const {
+        return commissioned_employees.size() + hourly_employees.size() + salaried_employees.size();
+    }
+
+private:
+    ObjectPool<CommissionedEmployee> commissioned_employees{};
+    ObjectPool<HourlyEmployee> hourly_employees{};
+    ObjectPool<SalariedEmployee> salaried_employees{};
+};
+
+// %%
+EmployeeRoster roster{};
+AbstractEmployee* pooled_employee{roster.create_employee(EmployeeType::hourly)};
+pooled_employee->calculate_pay();
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// Let's compare the time it takes to create (and destroy) a large roster:
+
+// %%
+template <typename CreateRosterFun>
+double measure_milliseconds_to_create_roster(CreateRosterFun create_roster) {
+    const auto start = std::chrono::steady_clock::now();
+    create_roster();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// %%
+void compare_roster_creation(std::size_t num_employees = 1'000'000) {
+    const auto make_unique_ms = measure_milliseconds_to_create_roster([num_employees]() {
+        std::vector<std::unique_ptr<AbstractEmployee>> employees{};
+        employees.reserve(num_employees);
+        for (std::size_t i{0}; i < num_employees; ++i) {
+            employees.push_back(create_employee(static_cast<EmployeeType>(i % 3)));
+        }
+    });
+    const auto roster_ms = measure_milliseconds_to_create_roster([num_employees]() {
+        EmployeeRoster roster{};
+        std::vector<AbstractEmployee*> employees{};
+        employees.reserve(num_employees);
+        for (std::size_t i{0}; i < num_employees; ++i) {
+            employees.push_back(roster.create_employee(static_cast<EmployeeType>(i % 3)));
+        }
+    });
+    std::cout << "std::make_unique(): " << make_unique_ms << " ms\n";
+    std::cout << "EmployeeRoster:     " << roster_ms << " ms\n";
+}
+
+// %%
+compare_roster_creation();
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Finding Employees by Name
+//
+// - `find_employee_by_name()` takes a `const std::string&`, so callers with a string literal or a `std::string_view` allocate a new string for each lookup
+// - An `EmployeeDirectory` maps names to the handles of the `EmployeeStore`
+//   - It is a `NameIndex`, which we will reuse for other data keyed by name
+//   - It takes names as `std::string_view` and never allocates for a lookup
+//   - It stores all names in one character buffer and uses an open-addressing hash table with linear probing
+//   - For a bulk load, it sizes the buffer and the table once and inserts all names in one pass
+
+// %%
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+// %% slideshow={"slide_type": "subslide"}
+template <typename Value>
+class NameIndex {
+public:
+    void add(std::string_view name, Value value) {
+        if (2 * (num_names + 1) > slots.size()) {
+            rehash(std::max<std::size_t>(16, 2 * slots.size()));
+        }
+        insert(name, value);
+    }
+
+    void bulk_load(const std::vector<std::string_view>& names, const std::vector<Value>& values) {
+        if (names.size() != values.size()) {
+            throw std::invalid_argument("Every name needs exactly one value.");
+        }
+        const auto total_name_length = std::accumulate(cbegin(names), cend(names), std::size_t{0},
+                                                       [](std::size_t sum, std::string_view name) { return sum + name.size(); });
+        name_storage.reserve(name_storage.size() + total_name_length);
+        rehash(compute_capacity(num_names + names.size()));
+        for (std::size_t i{0}; i < names.size(); ++i) {
+            insert(names[i], values[i]);
+        }
+    }
+
+    std::optional<Value> find(std::string_view name) const {
+        if (slots.empty()) {
+            return std::nullopt;
+        }
+        const auto hash = std::hash<std::string_view>{}(name);
+        for (auto index = hash & (slots.size() - 1);; index = (index + 1) & (slots.size() - 1)) {
+            const Slot& slot{slots[index]};
+            if (!slot.is_occupied) {
+                return std::nullopt;
+            }
+            if (slot.hash == hash && get_name(slot) == name) {
+                return slot.value;
+            }
+        }
+    }
+
+    std::size_t size() const { return num_names; }
+
+private:
+    struct Slot {
+        std::size_t hash{};
+        std::size_t name_offset{};
+        std::size_t name_length{};
+        Value value{};
+        bool is_occupied{false};
+    };
+
+    // Keeps the table at most half full, so that probe sequences stay short.
+    static std::size_t compute_capacity(std::size_t num_names) {
+        std::size_t capacity{16};
+        while (capacity < 2 * num_names) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    std::string_view get_name(const Slot& slot) const {
+        return std::string_view{name_storage}.substr(slot.name_offset, slot.name_length);
+    }
+
+    void insert(std::string_view name, Value value) {
+        const auto hash = std::hash<std::string_view>{}(name);
+        Slot& slot{find_slot(hash, name)};
+        if (!slot.is_occupied) {
+            slot = Slot{hash, name_storage.size(), name.size(), value, true};
+            name_storage.append(name);
+            ++num_names;
+        } else {
+            slot.value = value;
+        }
+    }
+
+    Slot& find_slot(std::size_t hash, std::string_view name) {
+        for (auto index = hash & (slots.size() - 1);; index = (index + 1) & (slots.size() - 1)) {
+            Slot& slot{slots[index]};
+            if (!slot.is_occupied || (slot.hash == hash && get_name(slot) == name)) {
+                return slot;
+            }
+        }
+    }
+
+    void rehash(std::size_t new_capacity) {
+        if (new_capacity <= slots.size()) {
+            return;
+        }
+        std::vector<Slot> old_slots(new_capacity);
+        std::swap(slots, old_slots);
+        for (const Slot& old_slot : old_slots) {
+            if (old_slot.is_occupied) {
+                find_slot(old_slot.hash, get_name(old_slot)) = old_slot;
+            }
+        }
+    }
+
+    std::vector<Slot> slots{};
+    std::string name_storage{};
+    std::size_t num_names{0};
+};
+
+// %%
+using EmployeeDirectory = NameIndex<EmployeeHandle>;
+
+// %%
+std::optional<EmployeeHandle> find_employee_by_name(const EmployeeDirectory& directory, std::string_view name) {
+    return directory.find(name);
+}
+
+// %% slideshow={"slide_type": "subslide"}
+EmployeeDirectory employee_directory{};
+employee_directory.bulk_load({"Joe", "Jack", "Jill"},
+                             {EmployeeHandle{EmployeeType::commissioned, 0}, EmployeeHandle{EmployeeType::hourly, 0},
+                              an_employee_handle});
+employee_directory.add("Jane", EmployeeHandle{EmployeeType::hourly, 0});
+
+// %%
+if (auto employee = find_employee_by_name(employee_directory, "Jill")) {
+    std::cout << "Jill earns " << employee_store.calculate_pay(*employee).amount_in_cents << " cents\n";
+}
+
+// %%
+find_employee_by_name(employee_directory, "Jim").has_value()
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Checking Many Passwords
+//
+// - `check_password()` copies both strings
+// - For every call it creates, encrypts and decrypts the phrase "Hello, world."
+// - A `CredentialStore` computes a *verifier* for each user when the password is set
+//   - Checking a password only computes the verifier for the given password and compares it with the stored one
+//   - The comparison always looks at all bytes, so its duration reveals nothing about the stored verifier
+//   - Many login attempts can be verified in one call
+
+// %%
+#include <array>
+#include <cstdint>
+
+// %%
+using PasswordVerifier = std::array<std::uint8_t, 32>;
+
+// %% slideshow={"slide_type": "subslide"}
+// Stand-in for a real password hashing function such as Argon2 or PBKDF2, like `get_encrypted_phrase()` above.
+PasswordVerifier compute_password_verifier(std::string_view salt, std::string_view password) {
+    std::uint64_t state{0xcbf2'9ce4'8422'2325};
+    auto mix_in = [&state](unsigned char c) { state = (state ^ c) * 0x100'0000'01b3; };
+    std::for_each(cbegin(salt), cend(salt), mix_in);
+    mix_in('\0');
+    std::for_each(cbegin(password), cend(password), mix_in);
+    PasswordVerifier verifier{};
+    for (auto& byte : verifier) {
+        state += 0x9e37'79b9'7f4a'7c15;
+        auto mixed = (state ^ (state >> 30)) * 0xbf58'476d'1ce4'e5b9;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94d0'49bb'1331'11eb;
+        byte = static_cast<std::uint8_t>(mixed >> 56);
+    }
+    return verifier;
+}
+
+// %%
+bool are_verifiers_equal(const PasswordVerifier& lhs, const PasswordVerifier& rhs) {
+    std::uint8_t difference{0};
+    for (std::size_t i{0}; i < lhs.size(); ++i) {
+        difference |= lhs[i] ^ rhs[i];
+    }
+    return difference == 0;
+}
+
+// %% slideshow={"slide_type": "subslide"}
+class CredentialStore {
+public:
+    void set_password(std::string_view user_name, std::string_view password) {
+        const auto verifier = compute_password_verifier(user_name, password);
+        if (auto user_index = user_indices.find(user_name)) {
+            verifiers[*user_index] = verifier;
+        } else {
+            user_indices.add(user_name, verifiers.size());
+            verifiers.push_back(verifier);
+        }
+    }
+
+    // For unknown users the verifier is compared with a dummy, so hashing and comparing take as long as for known
+    // users. The lookup itself still takes longer or shorter depending on the name, since `NameIndex::find()` stops
+    // at the first mismatch, so the duration can still hint at whether a user exists.
+    bool check_password(std::string_view user_name, std::string_view password) const {
+        const auto user_index = user_indices.find(user_name);
+        const auto& stored_verifier = user_index ? verifiers[*user_index] : unknown_user_verifier;
+        const bool is_matching{are_verifiers_equal(compute_password_verifier(user_name, password), stored_verifier)};
+        return is_matching && user_index.has_value();
+    }
+
+    std::vector<unsigned char> check_passwords(const std::vector<std::string_view>& user_names,
+                                               const std::vector<std::string_view>& passwords) const {
+        if (user_names.size() != passwords.size()) {
+            throw std::invalid_argument("Every user name needs exactly one password.");
+        }
+        std::vector<unsigned char> are_valid(user_names.size());
+        for (std::size_t i{0}; i < user_names.size(); ++i) {
+            are_valid[i] = check_password(user_names[i], passwords[i]);
+        }
+        return are_valid;
+    }
+
+private:
+    NameIndex<std::size_t> user_indices{};
+    std::vector<PasswordVerifier> verifiers{};
+    PasswordVerifier unknown_user_verifier{};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+CredentialStore credential_store{};
+credential_store.set_password("Joe", "asdf");
+credential_store.set_password("Jill", "correct horse battery staple");
+
+// %%
+credential_store.check_password("Joe", "asdf")
+
+// %%
+credential_store.check_password("Joe", "qwerty")
+
+// %%
+const auto login_results = credential_store.check_passwords({"Joe", "Jill", "Jim"}, {"asdf", "wrong", "asdf"});
+std::for_each(cbegin(login_results), cend(login_results), [](bool is_valid) { std::cout << is_valid << "\n"; });
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Sessions for Many Users
+//
+// - `check_password()` initializes the single global `session`
+// - Concurrent logins either have to wait for each other or race on it
+// - A `SessionTable` keeps one session per user, distributed over many shards
+//   - Each shard has its own lock, so logins of different users rarely wait for each other
+//   - Lookups only need a shared lock
+//   - Expired sessions are removed in one sweep per shard, not one by one
+
+// %%
+#include <shared_mutex>
+#include <unordered_map>
+
+// %%
+struct SessionEntry {
+    std::string user_name{};
+    std::uint64_t session_id{};
+    std::chrono::steady_clock::time_point expiration_time{};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+class SessionTable {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit SessionTable(Clock::duration time_to_live, std::size_t num_shards = 64)
+        : time_to_live{time_to_live}, shards(num_shards) {
+        if (num_shards == 0) {
+            throw std::invalid_argument("A session table needs at least one shard.");
+        }
+    }
+
+    std::uint64_t create_session(std::string_view user_name, Clock::time_point now = Clock::now()) {
+        const auto hash = std::hash<std::string_view>{}(user_name);
+        const auto session_id = next_session_id.fetch_add(1, std::memory_order_relaxed);
+        Shard& shard{get_shard(hash)};
+        std::unique_lock<std::shared_mutex> lock{shard.mutex};
+        if (auto* entry = find_entry(shard, hash, user_name)) {
+            entry->session_id = session_id;
+            entry->expiration_time = now + time_to_live;
+        } else {
+            shard.sessions.emplace(hash, SessionEntry{std::string{user_name}, session_id, now + time_to_live});
+        }
+        return session_id;
+    }
+
+    std::optional<std::uint64_t> find_session(std::string_view user_name, Clock::time_point now = Clock::now()) const {
+        const auto hash = std::hash<std::string_view>{}(user_name);
+        const Shard& shard{get_shard(hash)};
+        std::shared_lock<std::shared_mutex> lock{shard.mutex};
+        const auto* entry = find_entry(shard, hash, user_name);
+        if (entry == nullptr || entry->expiration_time <= now) {
+            return std::nullopt;
+        }
+        return entry->session_id;
+    }
+
+    std::size_t remove_expired_sessions(Clock::time_point now = Clock::now()) {
+        std::size_t num_removed{0};
+        for (Shard& shard : shards) {
+            std::unique_lock<std::shared_mutex> lock{shard.mutex};
+            for (auto it = begin(shard.sessions); it != end(shard.sessions);) {
+                if (it->second.expiration_time <= now) {
+                    it = shard.sessions.erase(it);
+                    ++num_removed;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return num_removed;
+    }
+
+    std::size_t size() const {
+        std::size_t num_sessions{0};
+        for (const Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock{shard.mutex};
+            num_sessions += shard.sessions.size();
+        }
+        return num_sessions;
+    }
+
+private:
+    // Sessions are keyed by the hash of the user name, so that a lookup does not have to create a `std::string`.
+    // Locking a shard writes to its mutex; the alignment keeps the mutexes of different shards apart.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex{};
+        std::unordered_multimap<std::size_t, SessionEntry> sessions{};
+    };
+
+    template <typename ShardType>
+    static auto find_entry(ShardType& shard, std::size_t hash, std::string_view user_name)
+        -> decltype(&shard.sessions.begin()->second) {
+        const auto [first, last] = shard.sessions.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            if (it->second.user_name == user_name) {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    Shard& get_shard(std::size_t hash) { return shards[hash % shards.size()]; }
+    const Shard& get_shard(std::size_t hash) const { return shards[hash % shards.size()]; }
+
+    Clock::duration time_to_live;
+    std::vector<Shard> shards;
+    std::atomic<std::uint64_t> next_session_id{1};
+};
+
+// %%
+std::optional<std::uint64_t> log_in(const CredentialStore& credentials, SessionTable& sessions,
+                                    std::string_view user_name, std::string_view password) {
+    if (!credentials.check_password(user_name, password)) {
+        return std::nullopt;
+    }
+    return sessions.create_session(user_name);
+}
+
+// %% slideshow={"slide_type": "subslide"}
+SessionTable session_table{std::chrono::minutes{30}};
+
+// %%
+log_in(credential_store, session_table, "Joe", "asdf").has_value()
+
+// %%
+session_table.find_session("Joe").has_value()
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// Many threads can log in users at the same time:
+
+// %%
+void log_in_concurrently(SessionTable& sessions, std::size_t num_threads, std::size_t num_users_per_thread) {
+    std::vector<std::thread> threads{};
+    for (std::size_t thread_index{0}; thread_index < num_threads; ++thread_index) {
+        threads.emplace_back([&sessions, thread_index, num_users_per_thread]() {
+            for (std::size_t i{0}; i < num_users_per_thread; ++i) {
+                sessions.create_session("user-" + std::to_string(thread_index) + "-" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// %%
+log_in_concurrently(session_table, 8, 10'000);
+std::cout << session_table.size() << " sessions\n";
+std::cout << session_table.remove_expired_sessions(std::chrono::steady_clock::now() + std::chrono::hours{1})
+          << " sessions expired\n";
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Checking Collisions Between Many Actors
+//
+// - `GoodActor::check_collision()` tests one pair of actors
+// - Testing every pair costs O(N²) calls per frame
+// - Most pairs are far apart and cannot collide
+// - A *broad phase* first finds candidate pairs whose bounding boxes overlap
+//   - Every actor is entered into the cells of a uniform grid that its bounding box covers
+//   - Only actors that share a cell are compared
+// - The existing `check_collision()` is then only called for the candidates (the *narrow phase*)
+
+// %%
+#include <cmath>
+
+// %%
+struct BoundingBox {
+    float min_x{};
+    float min_y{};
+    float max_x{};
+    float max_y{};
+};
+
+// %%
+bool do_bounding_boxes_overlap(const BoundingBox& lhs, const BoundingBox& rhs) {
+    return lhs.min_x <= rhs.max_x && rhs.min_x <= lhs.max_x && lhs.min_y <= rhs.max_y && rhs.min_y <= lhs.max_y;
+}
+
+// %%
+struct CollisionPair {
+    std::size_t first_actor{};
+    std::size_t second_actor{};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+class CollisionWorld {
+public:
+    explicit CollisionWorld(float cell_size) : cell_size{cell_size} {
+        if (!(cell_size > 0.0f)) {
+            throw std::invalid_argument("The cells of a collision grid need a positive size.");
+        }
+    }
+
+    std::size_t add_actor(const BoundingBox& actor_bounds) {
+        actors.emplace_back();
+        bounds.push_back(actor_bounds);
+        return actors.size() - 1;
+    }
+
+    void move_actor(std::size_t actor_index, const BoundingBox& actor_bounds) { bounds[actor_index] = actor_bounds; }
+
+    const std::vector<BoundingBox>& get_bounds() const { return bounds; }
+
+    std::size_t size() const { return actors.size(); }
+
+    std::vector<CollisionPair> find_collisions() {
+        std::vector<CollisionPair> collisions{};
+        for (const auto& candidate : find_candidate_pairs()) {
+            if (actors[candidate.first_actor].check_collision(actors[candidate.second_actor]).did_collision_occur) {
+                collisions.push_back(candidate);
+            }
+        }
+        return collisions;
+    }
+
+    std::vector<CollisionPair> find_candidate_pairs() {
+        fill_cell_entries();
+        std::vector<CollisionPair> candidates{};
+        for (auto cell_begin = cbegin(cell_entries); cell_begin != cend(cell_entries);) {
+            const auto cell_key = cell_begin->first;
+            const auto cell_end = std::find_if(cell_begin, cend(cell_entries),
+                                               [cell_key](const auto& entry) { return entry.first != cell_key; });
+            for (auto first = cell_begin; first != cell_end; ++first) {
+                for (auto second = std::next(first); second != cell_end; ++second) {
+                    if (is_candidate_pair_in_cell(first->second, second->second, cell_key)) {
+                        candidates.push_back({first->second, second->second});
+                    }
+                }
+            }
+            cell_begin = cell_end;
+        }
+        return candidates;
+    }
+
+private:
+    using CellKey = std::uint64_t;
+
+    CellKey compute_cell_key(std::int32_t cell_x, std::int32_t cell_y) const {
+        return (static_cast<CellKey>(static_cast<std::uint32_t>(cell_x)) << 32) | static_cast<std::uint32_t>(cell_y);
+    }
+
+    std::int32_t compute_cell_index(float coordinate) const {
+        return static_cast<std::int32_t>(std::floor(coordinate / cell_size));
+    }
+
+    // The buffer for the cell entries is reused from frame to frame.
+    void fill_cell_entries() {
+        cell_entries.clear();
+        for (std::size_t actor_index{0}; actor_index < actors.size(); ++actor_index) {
+            const auto& actor_bounds = bounds[actor_index];
+            for (auto cell_x = compute_cell_index(actor_bounds.min_x); cell_x <= compute_cell_index(actor_bounds.max_x);
+                 ++cell_x) {
+                for (auto cell_y = compute_cell_index(actor_bounds.min_y);
+                     cell_y <= compute_cell_index(actor_bounds.max_y); ++cell_y) {
+                    cell_entries.emplace_back(compute_cell_key(cell_x, cell_y), actor_index);
+                }
+            }
+        }
+        std::sort(begin(cell_entries), end(cell_entries));
+    }
+
+    // Two overlapping actors may share several cells. We report the pair only in the cell that contains the
+    // lower left corner of the overlap, so that every pair is reported exactly once.
+    bool is_candidate_pair_in_cell(std::size_t first_actor, std::size_t second_actor, CellKey cell_key) const {
+        const auto& first_bounds = bounds[first_actor];
+        const auto& second_bounds = bounds[second_actor];
+        if (!do_bounding_boxes_overlap(first_bounds, second_bounds)) {
+            return false;
+        }
+        const auto overlap_min_x = std::max(first_bounds.min_x, second_bounds.min_x);
+        const auto overlap_min_y = std::max(first_bounds.min_y, second_bounds.min_y);
+        return compute_cell_key(compute_cell_index(overlap_min_x), compute_cell_index(overlap_min_y)) == cell_key;
+    }
+
+    float cell_size;
+    std::vector<GoodActor> actors{};
+    std::vector<BoundingBox> bounds{};
+    std::vector<std::pair<CellKey, std::size_t>> cell_entries{};
+};
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// Let's compare the grid with checking all pairs:
+
+// %%
+// Always returns the same actors for the same arguments, so that all demos can be compared.
+std::vector<BoundingBox> create_random_bounds(std::size_t num_actors, float world_size, float actor_size) {
+    std::vector<BoundingBox> bounds{};
+    bounds.reserve(num_actors);
+    std::mt19937 generator{42};
+    std::uniform_real_distribution<float> position{0.0f, world_size};
+    for (std::size_t i{0}; i < num_actors; ++i) {
+        const float x{position(generator)};
+        const float y{position(generator)};
+        bounds.push_back({x, y, x + actor_size, y + actor_size});
+    }
+    return bounds;
+}
+
+// %%
+CollisionWorld create_random_collision_world(std::size_t num_actors, float world_size, float actor_size) {
+    CollisionWorld world{2.0f * actor_size};
+    for (const auto& actor_bounds : create_random_bounds(num_actors, world_size, actor_size)) {
+        world.add_actor(actor_bounds);
+    }
+    return world;
+}
+
+// %%
+std::size_t count_overlapping_pairs(const std::vector<BoundingBox>& bounds) {
+    std::size_t num_pairs{0};
+    for (std::size_t i{0}; i < bounds.size(); ++i) {
+        for (std::size_t j{i + 1}; j < bounds.size(); ++j) {
+            num_pairs += do_bounding_boxes_overlap(bounds[i], bounds[j]);
+        }
+    }
+    return num_pairs;
+}
+
+// %%
+void show_collision_world(std::size_t num_actors = 5'000) {
+    auto world = create_random_collision_world(num_actors, 5'000.0f, 10.0f);
+    auto start = std::chrono::steady_clock::now();
+    const auto collisions = world.find_collisions();
+    const std::chrono::duration<double, std::milli> grid_time{std::chrono::steady_clock::now() - start};
+    start = std::chrono::steady_clock::now();
+    const auto num_overlapping_pairs = count_overlapping_pairs(world.get_bounds());
+    const std::chrono::duration<double, std::milli> all_pairs_time{std::chrono::steady_clock::now() - start};
+    std::cout << num_actors << " actors, " << collisions.size() << " collisions found in " << grid_time.count()
+              << " ms\n";
+    std::cout << "All " << num_actors * (num_actors - 1) / 2 << " pairs: " << num_overlapping_pairs
+              << " overlapping in " << all_pairs_time.count() << " ms\n";
+}
+
+// %%
+show_collision_world();
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Testing Many Pairs at Once
+//
+// - Every call to `check_collision()` returns a `HitResult`, even though almost no pair collides
+// - The caller has to look at each of them to find the few collisions
+// - A batch narrow phase tests one actor against a whole block of actors
+//   - The bounding boxes are stored as separate columns, so the compiler can test several boxes with one SIMD instruction
+//   - A block without any collision is skipped after one check
+//   - Only the colliding pairs end up in the compact result
+
+// %%
+struct BoundingBoxColumns {
+    std::vector<float> min_x{};
+    std::vector<float> min_y{};
+    std::vector<float> max_x{};
+    std::vector<float> max_y{};
+
+    void push_back(const BoundingBox& box) {
+        min_x.push_back(box.min_x);
+        min_y.push_back(box.min_y);
+        max_x.push_back(box.max_x);
+        max_y.push_back(box.max_y);
+    }
+
+    // Keeps the capacity, so that refilling the columns does not allocate.
+    void clear() {
+        min_x.clear();
+        min_y.clear();
+        max_x.clear();
+        max_y.clear();
+    }
+
+    std::size_t size() const { return min_x.size(); }
+};
+
+// %%
+constexpr std::size_t collision_block_size{256};
+
+// %% slideshow={"slide_type": "subslide"}
+// Appends the pairs of `actor` with all colliding actors in `[first, last)`, which must not contain `actor` itself.
+void append_colliding_pairs(std::size_t actor, const BoundingBoxColumns& boxes, std::size_t first, std::size_t last,
+                            std::vector<CollisionPair>& collisions) {
+    const float min_x{boxes.min_x[actor]};
+    const float min_y{boxes.min_y[actor]};
+    const float max_x{boxes.max_x[actor]};
+    const float max_y{boxes.max_y[actor]};
+    std::array<unsigned char, collision_block_size> do_collide;
+    for (std::size_t block_begin{first}; block_begin < last; block_begin += collision_block_size) {
+        const std::size_t block_size{std::min(collision_block_size, last - block_begin)};
+        unsigned char does_any_collide{0};
+        for (std::size_t i{0}; i < block_size; ++i) {
+            const std::size_t other{block_begin + i};
+            do_collide[i] = (boxes.min_x[other] <= max_x) & (min_x <= boxes.max_x[other]) &
+                            (boxes.min_y[other] <= max_y) & (min_y <= boxes.max_y[other]);
+            does_any_collide |= do_collide[i];
+        }
+        if (does_any_collide) {
+            for (std::size_t i{0}; i < block_size; ++i) {
+                if (do_collide[i]) {
+                    collisions.push_back({actor, block_begin + i});
+                }
+            }
+        }
+    }
+}
+
+// %%
+std::vector<CollisionPair> find_colliding_pairs(const BoundingBoxColumns& boxes) {
+    std::vector<CollisionPair> collisions{};
+    for (std::size_t actor{0}; actor < boxes.size(); ++actor) {
+        append_colliding_pairs(actor, boxes, actor + 1, boxes.size(), collisions);
+    }
+    return collisions;
+}
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// Even without a broad phase, testing all pairs in blocks is much faster than calling `check_collision()` for each pair:
+
+// %%
+void compare_narrow_phases(std::size_t num_actors = 5'000) {
+    std::vector<GoodActor> actors(num_actors);
+    const auto bounds = create_random_bounds(num_actors, 2'000.0f, 10.0f);
+    BoundingBoxColumns boxes{};
+    for (const auto& actor_bounds : bounds) {
+        boxes.push_back(actor_bounds);
+    }
+
+    const auto pairwise_start = std::chrono::steady_clock::now();
+    std::size_t num_pairwise_collisions{0};
+    for (std::size_t i{0}; i < num_actors; ++i) {
+        for (std::size_t j{i + 1}; j < num_actors; ++j) {
+            if (do_bounding_boxes_overlap(bounds[i], bounds[j])) {
+                num_pairwise_collisions += actors[i].check_collision(actors[j]).did_collision_occur;
+            }
+        }
+    }
+    const auto batched_start = std::chrono::steady_clock::now();
+    const auto collisions = find_colliding_pairs(boxes);
+    const auto batched_end = std::chrono::steady_clock::now();
+
+    std::cout << "Pairwise: " << num_pairwise_collisions << " collisions in "
+              << std::chrono::duration<double, std::milli>(batched_start - pairwise_start).count() << " ms\n";
+    std::cout << "Batched:  " << collisions.size() << " collisions in "
+              << std::chrono::duration<double, std::milli>(batched_end - batched_start).count() << " ms\n";
+}
+
+// %%
+compare_narrow_phases();
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Collisions From Frame to Frame
+//
+// - The collision checks so far start from scratch in every frame
+// - But actors move only a little between frames
+// - The `CoherentCollisionSystem` keeps its state between frames:
+//   - The actors stay sorted by the left edge of their bounding box (*sweep and prune*); after small movements insertion sort restores the order in almost linear time
+//   - The contacts of the last frame are kept, so that we can report which contacts started and ended
+// - The sweep is split across several threads, each with its own result buffer
+//   - The threads are started once and wait for the next frame
+// - Every frame records timing counters
+
+// %%
+#include <condition_variable>
+#include <functional>
+#include <tuple>
+
+// %%
+struct CollisionFrameCounters {
+    std::chrono::duration<double, std::milli> sort_time{};
+    std::chrono::duration<double, std::milli> sweep_time{};
+    std::chrono::duration<double, std::milli> contact_update_time{};
+    std::size_t num_swaps{};
+    std::size_t num_contacts{};
+    std::size_t num_started_contacts{};
+    std::size_t num_ended_contacts{};
+};
+
+// %%
+bool operator<(const CollisionPair& lhs, const CollisionPair& rhs) {
+    return std::tie(lhs.first_actor, lhs.second_actor) < std::tie(rhs.first_actor, rhs.second_actor);
+}
+
+// %%
+bool operator==(const CollisionPair& lhs, const CollisionPair& rhs) {
+    return std::tie(lhs.first_actor, lhs.second_actor) == std::tie(rhs.first_actor, rhs.second_actor);
+}
+
+// %% slideshow={"slide_type": "subslide"}
+// Threads that are started once and then run one task per frame.
+class FrameWorkers {
+public:
+    explicit FrameWorkers(std::size_t num_threads) {
+        for (std::size_t thread_index{0}; thread_index < num_threads; ++thread_index) {
+            threads.emplace_back([this, thread_index]() { run_tasks(thread_index); });
+        }
+    }
+
+    ~FrameWorkers() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            is_stopping = true;
+        }
+        task_available.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    FrameWorkers(const FrameWorkers&) = delete;
+    FrameWorkers& operator=(const FrameWorkers&) = delete;
+
+    std::size_t size() const { return threads.size(); }
+
+    // Calls `task(thread_index)` on every thread and returns once all of them are done.
+    void run(const std::function<void(std::size_t)>& task) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            current_task = &task;
+            num_busy_threads = threads.size();
+            ++frame_number;
+        }
+        task_available.notify_all();
+        std::unique_lock<std::mutex> lock{mutex};
+        frame_done.wait(lock, [this]() { return num_busy_threads == 0; });
+    }
+
+private:
+    void run_tasks(std::size_t thread_index) {
+        std::size_t last_frame_number{0};
+        std::unique_lock<std::mutex> lock{mutex};
+        while (true) {
+            task_available.wait(lock, [&]() { return is_stopping || frame_number != last_frame_number; });
+            if (is_stopping) {
+                return;
+            }
+            last_frame_number = frame_number;
+            const auto& task = *current_task;
+            lock.unlock();
+            task(thread_index);
+            lock.lock();
+            if (--num_busy_threads == 0) {
+                frame_done.notify_one();
+            }
+        }
+    }
+
+    std::mutex mutex{};
+    std::condition_variable task_available{};
+    std::condition_variable frame_done{};
+    std::size_t frame_number{0};
+    std::size_t num_busy_threads{0};
+    bool is_stopping{false};
+    const std::function<void(std::size_t)>* current_task{nullptr};
+    std::vector<std::thread> threads{};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+// The contacts found by one sweep thread. Aligned so that no two threads write to the same cache line.
+struct alignas(64) ThreadContacts {
+    std::vector<CollisionPair> pairs{};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+class CoherentCollisionSystem {
+public:
+    explicit CoherentCollisionSystem(std::size_t num_threads = std::thread::hardware_concurrency())
+        : thread_contacts(std::max<std::size_t>(num_threads, 1)), workers{thread_contacts.size()} {}
+
+    std::size_t add_actor(const BoundingBox& actor_bounds) {
+        bounds.push_back(actor_bounds);
+        sorted_actors.push_back(bounds.size() - 1);
+        is_sorted_order_valid = false;
+        return bounds.size() - 1;
+    }
+
+    void move_actor(std::size_t actor, const BoundingBox& actor_bounds) { bounds[actor] = actor_bounds; }
+
+    void update() {
+        using Clock = std::chrono::steady_clock;
+        const auto start = Clock::now();
+        counters.num_swaps = update_sorted_order();
+        const auto sorted = Clock::now();
+        sweep_in_parallel();
+        const auto swept = Clock::now();
+        update_contacts();
+        const auto end = Clock::now();
+        counters.sort_time = sorted - start;
+        counters.sweep_time = swept - sorted;
+        counters.contact_update_time = end - swept;
+    }
+
+    const std::vector<CollisionPair>& get_contacts() const { return contacts; }
+    const std::vector<CollisionPair>& get_started_contacts() const { return started_contacts; }
+    const std::vector<CollisionPair>& get_ended_contacts() const { return ended_contacts; }
+    const CollisionFrameCounters& get_last_frame_counters() const { return counters; }
+
+private:
+    // After the first frame the actors are almost sorted, and insertion sort needs only a few swaps.
+    std::size_t update_sorted_order() {
+        const auto is_left_of = [this](std::size_t lhs, std::size_t rhs) { return bounds[lhs].min_x < bounds[rhs].min_x; };
+        std::size_t num_swaps{0};
+        if (!is_sorted_order_valid) {
+            std::sort(begin(sorted_actors), end(sorted_actors), is_left_of);
+            is_sorted_order_valid = true;
+        } else {
+            for (std::size_t i{1}; i < sorted_actors.size(); ++i) {
+                for (std::size_t j{i}; j > 0 && is_left_of(sorted_actors[j], sorted_actors[j - 1]); --j) {
+                    std::swap(sorted_actors[j], sorted_actors[j - 1]);
+                    ++num_swaps;
+                }
+            }
+        }
+        sorted_boxes.clear();
+        for (auto actor : sorted_actors) {
+            sorted_boxes.push_back(bounds[actor]);
+        }
+        return num_swaps;
+    }
+
+    // Thread `t` handles the sorted positions t, t + num_threads, ..., which spreads the dense regions evenly.
+    void sweep_in_parallel() {
+        const auto num_threads = workers.size();
+        workers.run([this, num_threads](std::size_t thread_index) {
+            auto& found_contacts = thread_contacts[thread_index].pairs;
+            found_contacts.clear();
+            for (std::size_t position{thread_index}; position < sorted_actors.size(); position += num_threads) {
+                const auto sweep_end = std::upper_bound(cbegin(sorted_boxes.min_x) + position + 1,
+                                                        cend(sorted_boxes.min_x), sorted_boxes.max_x[position]);
+                append_colliding_pairs(position, sorted_boxes, position + 1, sweep_end - cbegin(sorted_boxes.min_x),
+                                       found_contacts);
+            }
+        });
+    }
+
+    void update_contacts() {
+        std::swap(contacts, previous_contacts);
+        contacts.clear();
+        for (const auto& found_contacts : thread_contacts) {
+            for (const auto& [first_position, second_position] : found_contacts.pairs) {
+                const auto first_actor = sorted_actors[first_position];
+                const auto second_actor = sorted_actors[second_position];
+                contacts.push_back({std::min(first_actor, second_actor), std::max(first_actor, second_actor)});
+            }
+        }
+        std::sort(begin(contacts), end(contacts));
+        started_contacts.clear();
+        ended_contacts.clear();
+        std::set_difference(cbegin(contacts), cend(contacts), cbegin(previous_contacts), cend(previous_contacts),
+                            std::back_inserter(started_contacts));
+        std::set_difference(cbegin(previous_contacts), cend(previous_contacts), cbegin(contacts), cend(contacts),
+                            std::back_inserter(ended_contacts));
+        counters.num_contacts = contacts.size();
+        counters.num_started_contacts = started_contacts.size();
+        counters.num_ended_contacts = ended_contacts.size();
+    }
+
+    std::vector<BoundingBox> bounds{};
+    std::vector<std::size_t> sorted_actors{};
+    bool is_sorted_order_valid{true};
+    BoundingBoxColumns sorted_boxes{};
+    std::vector<ThreadContacts> thread_contacts;
+    std::vector<CollisionPair> contacts{};
+    std::vector<CollisionPair> previous_contacts{};
+    std::vector<CollisionPair> started_contacts{};
+    std::vector<CollisionPair> ended_contacts{};
+    CollisionFrameCounters counters{};
+    FrameWorkers workers;
+};
+
+// %% slideshow={"slide_type": "subslide"}
+void print_frame_counters(std::size_t frame, const CollisionFrameCounters& counters) {
+    std::printf("Frame %2zu: sort %6.2f ms (%6zu swaps), sweep %6.2f ms, contacts %6.2f ms: "
+                "%zu contacts (%zu started, %zu ended)\n",
+                frame, counters.sort_time.count(), counters.num_swaps, counters.sweep_time.count(),
+                counters.contact_update_time.count(), counters.num_contacts, counters.num_started_contacts,
+                counters.num_ended_contacts);
+}
+
+// %%
+// Puts the lower actor first in every pair and sorts the pairs, as the `CoherentCollisionSystem` does.
+std::vector<CollisionPair> sort_collisions(std::vector<CollisionPair> collisions) {
+    for (auto& [first_actor, second_actor] : collisions) {
+        if (second_actor < first_actor) {
+            std::swap(first_actor, second_actor);
+        }
+    }
+    std::sort(begin(collisions), end(collisions));
+    return collisions;
+}
+
+// %%
+sort_collisions({{5, 3}, {1, 2}, {4, 0}}) == std::vector<CollisionPair>{{0, 4}, {1, 2}, {3, 5}}
+
+// %%
+// The contacts found by the grid, in the same order as those of the `CoherentCollisionSystem`.
+std::vector<CollisionPair> find_sorted_collisions(CollisionWorld& world) {
+    return sort_collisions(world.find_collisions());
+}
+
+// %% slideshow={"slide_type": "subslide"}
+void simulate_collision_frames(std::size_t num_actors = 20'000, std::size_t num_frames = 10) {
+    CoherentCollisionSystem collision_system{};
+    CollisionWorld world{20.0f};
+    std::size_t num_frames_matching_grid{0};
+    auto bounds = create_random_bounds(num_actors, 10'000.0f, 10.0f);
+    for (const auto& actor_bounds : bounds) {
+        collision_system.add_actor(actor_bounds);
+        world.add_actor(actor_bounds);
+    }
+    std::mt19937 generator{42};
+    std::uniform_real_distribution<float> movement{-1.0f, 1.0f};
+    for (std::size_t frame{0}; frame < num_frames; ++frame) {
+        for (std::size_t actor{0}; actor < num_actors; ++actor) {
+            const float dx{movement(generator)};
+            const float dy{movement(generator)};
+            auto& box = bounds[actor];
+            box = {box.min_x + dx, box.min_y + dy, box.max_x + dx, box.max_y + dy};
+            collision_system.move_actor(actor, box);
+            world.move_actor(actor, box);
+        }
+        collision_system.update();
+        print_frame_counters(frame, collision_system.get_last_frame_counters());
+        num_frames_matching_grid += collision_system.get_contacts() == find_sorted_collisions(world);
+    }
+    std::cout << "Contacts match the grid in " << num_frames_matching_grid << " of " << num_frames << " frames\n";
+}
+
+// %%
+simulate_collision_frames();
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### A Traffic Estimator That Runs for Weeks
+//
+// - `TrafficEstimator::save_estimate()` appends every estimate to a vector
+// - A sensor that runs for weeks uses more and more memory, and the vector has to be copied whenever it grows
+// - A `BoundedTrafficEstimator` keeps only the most recent estimates in a ring buffer of fixed capacity
+// - It updates the sum, mean, minimum and maximum of the estimates in the window with every new estimate
+//   - The sum is updated by adding the new and subtracting the dropped estimate
+//   - For the minimum and maximum it keeps a queue of the estimates that can still become the extremum (a *monotonic queue*), also in a fixed-size ring
+
+// %% slideshow={"slide_type": "subslide"}
+// Keeps the candidates for the extremum of the last `capacity` values, ordered by `Compare`.
+template <typename Compare>
+class SlidingWindowExtremum {
+public:
+    explicit SlidingWindowExtremum(std::size_t capacity) : candidates(capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("A sliding window needs room for at least one value.");
+        }
+    }
+
+    void push(std::uint64_t sequence_number, int value) {
+        while (num_candidates > 0 && !Compare{}(back().value, value)) {
+            --num_candidates;
+        }
+        candidates[(first_index + num_candidates) % candidates.size()] = Candidate{sequence_number, value};
+        ++num_candidates;
+    }
+
+    void drop_older_than(std::uint64_t oldest_sequence_number) {
+        while (num_candidates > 0 && candidates[first_index].sequence_number < oldest_sequence_number) {
+            first_index = (first_index + 1) % candidates.size();
+            --num_candidates;
+        }
+    }
+
+    std::optional<int> get() const {
+        return num_candidates > 0 ? std::optional<int>{candidates[first_index].value} : std::nullopt;
+    }
+
+private:
+    struct Candidate {
+        std::uint64_t sequence_number{};
+        int value{};
+    };
+
+    Candidate& back() { return candidates[(first_index + num_candidates - 1) % candidates.size()]; }
+
+    std::vector<Candidate> candidates;
+    std::size_t first_index{0};
+    std::size_t num_candidates{0};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+class BoundedTrafficEstimator {
+public:
+    // Throws `std::invalid_argument` if `capacity` is 0.
+    explicit BoundedTrafficEstimator(std::size_t capacity)
+        : estimates(capacity), minimum{capacity}, maximum{capacity} {}
+
+    void add_data(int vehicles_lane_a, int vehicles_lane_b) {
+        auto new_estimate = compute_estimate(vehicles_lane_a, vehicles_lane_b);
+        save_estimate(new_estimate);
+    }
+
+    std::size_t size() const { return std::min<std::uint64_t>(num_estimates_added, estimates.size()); }
+    long get_sum() const { return sum; }
+    // The mean, minimum and maximum are empty as long as no estimate has been added.
+    std::optional<double> get_mean() const {
+        if (size() == 0) {
+            return std::nullopt;
+        }
+        return static_cast<double>(sum) / size();
+    }
+    std::optional<int> get_min() const { return minimum.get(); }
+    std::optional<int> get_max() const { return maximum.get(); }
+
+    // Calls `process_estimate` for the estimates in the window, from the oldest to the newest.
+    template <typename EstimateFun>
+    void for_each_estimate(EstimateFun process_estimate) const {
+        for (auto sequence_number = num_estimates_added - size(); sequence_number < num_estimates_added;
+             ++sequence_number) {
+            process_estimate(estimates[sequence_number % estimates.size()]);
+        }
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const BoundedTrafficEstimator& estimator) {
+        estimator.for_each_estimate([&os](int r) { os << r << "\n"; });
+        return os;
+    }
+
+private:
+    static int compute_estimate(int vehicles_lane_a, int vehicles_lane_b) {
+        return vehicles_lane_a + vehicles_lane_b;
+    }
+
+    void save_estimate(int new_estimate) {
+        auto& slot = estimates[num_estimates_added % estimates.size()];
+        if (num_estimates_added >= estimates.size()) {
+            sum -= slot;
+        }
+        slot = new_estimate;
+        sum += new_estimate;
+        // Drop expired candidates first so that the new one always fits into the ring.
+        const auto new_window_size = std::min<std::uint64_t>(num_estimates_added + 1, estimates.size());
+        const auto oldest_sequence_number = num_estimates_added + 1 - new_window_size;
+        minimum.drop_older_than(oldest_sequence_number);
+        maximum.drop_older_than(oldest_sequence_number);
+        minimum.push(num_estimates_added, new_estimate);
+        maximum.push(num_estimates_added, new_estimate);
+        ++num_estimates_added;
+    }
+
+    std::vector<int> estimates;
+    std::uint64_t num_estimates_added{0};
+    long sum{0};
+    SlidingWindowExtremum<std::less<>> minimum;
+    SlidingWindowExtremum<std::greater<>> maximum;
+};
+
+// %% slideshow={"slide_type": "subslide"}
+BoundedTrafficEstimator bounded_estimator{3};
+for (auto [lane_a, lane_b] : {std::pair{1, 2}, std::pair{4, 6}, std::pair{2, 2}, std::pair{0, 1}}) {
+    bounded_estimator.add_data(lane_a, lane_b);
+}
+std::cout << bounded_estimator;
+std::cout << "sum: " << bounded_estimator.get_sum() << ", mean: " << *bounded_estimator.get_mean()
+          << ", min: " << *bounded_estimator.get_min() << ", max: " << *bounded_estimator.get_max() << "\n";
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Many Sensors, One Estimator
+//
+// - If several sensor threads call `add_data()` directly, the estimator needs a lock, and the sensors wait for each other
+// - Instead, sensors push their samples into a bounded, lock-free queue
+//   - Every slot carries a sequence number that tells producers and the consumer whose turn it is
+//   - Producers reserve a slot with a single compare-and-swap on the write position
+// - A single consumer drains the queue in batches and feeds the samples to the estimator
+// - If the queue is full, the sample is dropped (or the sensor waits), and counters record how often that happens
+//   - The number of accepted samples needs no counter of its own: it is the write position
+
+// %%
+#include <limits>
+#include <stdexcept>
+
+// %% slideshow={"slide_type": "subslide"}
+struct SensorSample {
+    int vehicles_lane_a{};
+    int vehicles_lane_b{};
+};
+
+// Bounded multi-producer queue after Dmitry Vyukov; `capacity` must be a power of two.
+class SensorSampleQueue {
+public:
+    explicit SensorSampleQueue(std::size_t capacity) : slots(capacity), index_mask{capacity - 1} {
+        if (capacity < 2 || (capacity & index_mask) != 0) {
+            throw std::invalid_argument("Queue capacity must be a power of two, at least 2.");
+        }
+        for (std::size_t i{0}; i < capacity; ++i) {
+            slots[i].sequence_number.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(SensorSample sample) {
+        auto position = write_position.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = slots[position & index_mask];
+            const auto sequence_number = slot.sequence_number.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::ptrdiff_t>(sequence_number - position);
+            if (difference == 0) {
+                if (write_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.sample = sample;
+                    slot.sequence_number.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false; // The consumer has not yet emptied this slot: the queue is full.
+            } else {
+                position = write_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Must only be called from the single consumer thread.
+    bool try_pop(SensorSample& sample) {
+        auto& slot = slots[read_position & index_mask];
+        if (slot.sequence_number.load(std::memory_order_acquire) != read_position + 1) {
+            return false;
+        }
+        sample = slot.sample;
+        slot.sequence_number.store(read_position + slots.size(), std::memory_order_release);
+        ++read_position;
+        return true;
+    }
+
+    // Every successful push advances the write position by one, so it is also the number of pushed samples.
+    std::size_t get_num_pushed() const { return write_position.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<std::size_t> sequence_number{0};
+        SensorSample sample{};
+    };
+
+    std::vector<Slot> slots;
+    const std::size_t index_mask;
+    alignas(64) std::atomic<std::size_t> write_position{0};
+    alignas(64) std::size_t read_position{0};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+struct IngestionCounters {
+    std::uint64_t num_accepted{};
+    std::uint64_t num_dropped{};
+    std::uint64_t num_producer_waits{};
+    std::uint64_t num_batches{};
+};
+
+class TrafficDataIngestion {
+public:
+    explicit TrafficDataIngestion(std::size_t queue_capacity) : queue{queue_capacity} {}
+
+    // Called by any number of sensor threads; drops the sample if the queue is full.
+    bool add_data(int vehicles_lane_a, int vehicles_lane_b) {
+        if (queue.try_push({vehicles_lane_a, vehicles_lane_b})) {
+            return true;
+        }
+        num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Called by sensor threads whose samples must not be lost; waits while the queue is full.
+    void add_data_waiting(int vehicles_lane_a, int vehicles_lane_b) {
+        while (!queue.try_push({vehicles_lane_a, vehicles_lane_b})) {
+            num_producer_waits.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    // Called by the single consumer thread; returns the number of samples passed to the estimator.
+    template <typename Estimator>
+    std::size_t drain_into(Estimator& estimator, std::size_t max_batch_size = 1024) {
+        std::size_t num_drained{0};
+        SensorSample sample{};
+        while (num_drained < max_batch_size && queue.try_pop(sample)) {
+            estimator.add_data(sample.vehicles_lane_a, sample.vehicles_lane_b);
+            ++num_drained;
+        }
+        if (num_drained > 0) {
+            num_batches.fetch_add(1, std::memory_order_relaxed);
+        }
+        return num_drained;
+    }
+
+    IngestionCounters get_counters() const {
+        return {queue.get_num_pushed(), num_dropped.load(std::memory_order_relaxed),
+                num_producer_waits.load(std::memory_order_relaxed), num_batches.load(std::memory_order_relaxed)};
+    }
+
+private:
+    SensorSampleQueue queue;
+    std::atomic<std::uint64_t> num_dropped{0};
+    std::atomic<std::uint64_t> num_producer_waits{0};
+    std::atomic<std::uint64_t> num_batches{0};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+void ingest_concurrently(int num_sensors, int samples_per_sensor, bool wait_when_full) {
+    TrafficDataIngestion ingestion{1024};
+    BoundedTrafficEstimator estimator{4096};
+    std::atomic<int> num_active_sensors{num_sensors};
+
+    std::vector<std::thread> sensors{};
+    for (int sensor{0}; sensor < num_sensors; ++sensor) {
+        sensors.emplace_back([&, sensor] {
+            for (int i{0}; i < samples_per_sensor; ++i) {
+                if (wait_when_full) {
+                    ingestion.add_data_waiting(sensor, i % 10);
+                } else {
+                    ingestion.add_data(sensor, i % 10);
+                }
+            }
+            num_active_sensors.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    std::size_t num_processed{0};
+    while (num_active_sensors.load(std::memory_order_acquire) > 0) {
+        num_processed += ingestion.drain_into(estimator);
+    }
+    num_processed += ingestion.drain_into(estimator, std::numeric_limits<std::size_t>::max());
+    for (auto& sensor : sensors) {
+        sensor.join();
+    }
+
+    const auto counters = ingestion.get_counters();
+    std::cout << (wait_when_full ? "Waiting" : "Dropping") << " sensors: " << counters.num_accepted
+              << " accepted, " << counters.num_dropped << " dropped, " << counters.num_producer_waits
+              << " waits, " << num_processed << " processed in " << counters.num_batches << " batches\n";
+}
+
+// %%
+ingest_concurrently(4, 100'000, false);
+ingest_concurrently(4, 100'000, true);
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Printing Only What Is New
+//
+// - `process_new_sensor_data()` and `operator<<` print *all* results for every new sample
+// - For $n$ samples this prints $n^2/2$ lines, although only $n$ of them are new
+// - A `DeltaPrinter` is bound to one vector of values; it remembers how many of them it has already printed (a *cursor*) and prints only the rest when it is flushed
+//   - Whoever clears the values has to reset the printer; the printer cannot tell cleared values from new ones
+// - An estimator can also notify subscribers of every new estimate, so that they stream it to a sink without keeping a cursor at all
+
+// %%
+#include <sstream>
+
+// %% slideshow={"slide_type": "subslide"}
+class DeltaPrinter {
+public:
+    DeltaPrinter(const std::vector<int>& values, std::ostream& os) : values{values}, os{os} {}
+
+    // Prints the values that were added since the last flush.
+    void flush() {
+        if (num_printed > values.size()) {
+            throw std::logic_error("The values were cleared without resetting the printer.");
+        }
+        std::for_each(cbegin(values) + num_printed, cend(values), [this](int r) { os << r << "\n"; });
+        num_printed = values.size();
+    }
+
+    // Call this after clearing the values, so that the next flush prints all values from the start.
+    void reset() { num_printed = 0; }
+
+private:
+    const std::vector<int>& values;
+    std::ostream& os;
+    std::size_t num_printed{0};
+};
+
+// %%
+void process_new_sensor_data(int a, int b, std::vector<int>& results, DeltaPrinter& printer) {
+    auto new_result = compute_result(a, b);
+    save_result(new_result, results);
+    printer.flush();
+}
+
+// %%
+std::vector<int> my_new_results{};
+DeltaPrinter result_printer{my_new_results, std::cout};
+std::cout << ">>> 1 <<<\n";
+process_new_sensor_data(1, 2, my_new_results, result_printer);
+std::cout << "\n>>> 2 <<<\n";
+process_new_sensor_data(4, 6, my_new_results, result_printer);
+
+// %% slideshow={"slide_type": "subslide"}
+class StreamingTrafficEstimator {
+public:
+    using EstimateSink = std::function<void(int)>;
+    using SubscriptionId = std::size_t;
+
+    void add_data(int vehicles_lane_a, int vehicles_lane_b) {
+        auto new_estimate = compute_estimate(vehicles_lane_a, vehicles_lane_b);
+        save_estimate(new_estimate);
+    }
+
+    const std::vector<int>& get_estimates() const { return estimates; }
+
+    SubscriptionId subscribe(EstimateSink sink) {
+        subscriptions.push_back({next_subscription_id, std::move(sink)});
+        return next_subscription_id++;
+    }
+
+    void unsubscribe(SubscriptionId id) {
+        subscriptions.erase(std::remove_if(begin(subscriptions), end(subscriptions),
+                                           [id](const Subscription& s) { return s.id == id; }),
+                            end(subscriptions));
+    }
+
+private:
+    struct Subscription {
+        SubscriptionId id;
+        EstimateSink sink;
+    };
+
+    static int compute_estimate(int vehicles_lane_a, int vehicles_lane_b) {
+        return vehicles_lane_a + vehicles_lane_b;
+    }
+
+    void save_estimate(int new_estimate) {
+        estimates.push_back(new_estimate);
+        for (auto& subscription : subscriptions) {
+            subscription.sink(new_estimate);
+        }
+    }
+
+    std::vector<int> estimates{};
+    std::vector<Subscription> subscriptions{};
+    SubscriptionId next_subscription_id{0};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+StreamingTrafficEstimator streaming_estimator{};
+auto console_subscription{streaming_estimator.subscribe([](int r) { std::cout << "new estimate: " << r << "\n"; })};
+streaming_estimator.add_data(1, 2);
+streaming_estimator.add_data(4, 6);
+streaming_estimator.unsubscribe(console_subscription);
+streaming_estimator.add_data(2, 2);
+streaming_estimator.get_estimates().size()
+
+// %% slideshow={"slide_type": "subslide"}
+void compare_output_costs(int num_samples) {
+    TrafficEstimator full_estimator{};
+    std::ostringstream full_output{};
+    auto start{std::chrono::steady_clock::now()};
+    for (int i{0}; i < num_samples; ++i) {
+        full_estimator.add_data(i % 7, i % 5);
+        full_output << full_estimator;
+    }
+    std::chrono::duration<double, std::milli> full_time{std::chrono::steady_clock::now() - start};
+
+    TrafficEstimator delta_estimator{};
+    std::ostringstream delta_output{};
+    DeltaPrinter delta_printer{delta_estimator.get_estimates(), delta_output};
+    start = std::chrono::steady_clock::now();
+    for (int i{0}; i < num_samples; ++i) {
+        delta_estimator.add_data(i % 7, i % 5);
+        delta_printer.flush();
+    }
+    std::chrono::duration<double, std::milli> delta_time{std::chrono::steady_clock::now() - start};
+
+    std::cout << "Reprinting everything: " << full_output.str().size() << " bytes in " << full_time.count()
+              << "ms\n";
+    std::cout << "Printing new estimates: " << delta_output.str().size() << " bytes in " << delta_time.count()
+              << "ms\n";
+}
+
+// %%
+compare_output_costs(2'000);
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Keeping Estimates Across Restarts
+//
+// - The estimates live only in memory; rebuilding them from the sensor logs takes minutes
+// - We store them in a binary file with a simple columnar layout:
+//   - A file header with a magic number, a format version, a byte-order mark and the block capacity
+//   - Fixed-size blocks, each with the number of values, a checksum, and the estimates as 32-bit integers
+// - New estimates are appended to the last block; blocks never move
+// - On restart we map the file into memory (`mmap`) and use the estimates in place, without parsing or copying them
+// - Checksums are only verified on request, so that opening the file costs the same, no matter how large it is
+
+// %%
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// %% slideshow={"slide_type": "subslide"}
+static_assert(sizeof(int) == sizeof(std::int32_t), "Estimates are stored as 32-bit integers.");
+
+constexpr char estimate_file_magic[8]{'T', 'R', 'A', 'F', 'E', 'S', 'T', '\0'};
+constexpr std::uint32_t estimate_file_version{1};
+constexpr std::uint32_t estimate_file_byte_order_mark{0x01020304};
+
+struct EstimateFileHeader {
+    char magic[8]{};
+    std::uint32_t version{};
+    std::uint32_t byte_order_mark{};
+    std::uint32_t block_capacity{};
+    std::uint32_t reserved[3]{};
+};
+
+struct EstimateBlockHeader {
+    std::uint32_t num_values{};
+    std::uint32_t checksum{};
+};
+
+// FNV-1a, which can be continued when values are appended to a block.
+constexpr std::uint32_t empty_block_checksum{2166136261u};
+
+std::uint32_t update_block_checksum(std::uint32_t checksum, const std::int32_t* values, std::size_t num_values) {
+    auto bytes{reinterpret_cast<const unsigned char*>(values)};
+    for (std::size_t i{0}; i < num_values * sizeof(std::int32_t); ++i) {
+        checksum = (checksum ^ bytes[i]) * 16777619u;
+    }
+    return checksum;
+}
+
+std::size_t get_block_offset(std::uint32_t block_capacity, std::size_t block_index) {
+    return sizeof(EstimateFileHeader) +
+           block_index * (sizeof(EstimateBlockHeader) + block_capacity * sizeof(std::int32_t));
+}
+
+// %% slideshow={"slide_type": "subslide"}
+class FileDescriptor {
+public:
+    FileDescriptor(const std::string& path, int flags) : fd{::open(path.c_str(), flags, 0644)} {
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+        }
+    }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    ~FileDescriptor() { ::close(fd); }
+
+    int get() const { return fd; }
+
+    std::size_t get_size() const {
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            throw std::system_error(errno, std::generic_category(), "Cannot determine file size");
+        }
+        return static_cast<std::size_t>(status.st_size);
+    }
+
+    void write_at(const void* data, std::size_t size, std::size_t offset) const {
+        auto bytes{static_cast<const char*>(data)};
+        while (size > 0) {
+            auto num_written{::pwrite(fd, bytes, size, static_cast<off_t>(offset))};
+            if (num_written < 0) {
+                throw std::system_error(errno, std::generic_category(), "Cannot write estimate file");
+            }
+            bytes += num_written;
+            size -= static_cast<std::size_t>(num_written);
+            offset += static_cast<std::size_t>(num_written);
+        }
+    }
+
+    void read_at(void* data, std::size_t size, std::size_t offset) const {
+        if (::pread(fd, data, size, static_cast<off_t>(offset)) != static_cast<ssize_t>(size)) {
+            throw std::runtime_error("Estimate file is truncated.");
+        }
+    }
+
+private:
+    int fd;
+};
+
+void check_estimate_file_header(const EstimateFileHeader& header) {
+    if (std::memcmp(header.magic, estimate_file_magic, sizeof(estimate_file_magic)) != 0) {
+        throw std::runtime_error("Not an estimate file.");
+    }
+    if (header.byte_order_mark != estimate_file_byte_order_mark) {
+        throw std::runtime_error("Estimate file was written with a different byte order.");
+    }
+    if (header.version != estimate_file_version) {
+        throw std::runtime_error("Unsupported estimate file version " + std::to_string(header.version) + ".");
+    }
+    if (header.block_capacity == 0) {
+        throw std::runtime_error("Estimate file has an invalid block capacity.");
+    }
+}
+
+// %% slideshow={"slide_type": "subslide"}
+class EstimateFileWriter {
+public:
+    // `block_capacity` only applies to a new file; an existing file keeps the capacity stored in its header.
+    EstimateFileWriter(const std::string& path, std::uint32_t block_capacity = 4096)
+        : file{path, O_RDWR | O_CREAT} {
+        if (block_capacity == 0) {
+            throw std::invalid_argument("An estimate file block needs room for at least one value.");
+        }
+        if (file.get_size() == 0) {
+            std::memcpy(header.magic, estimate_file_magic, sizeof(estimate_file_magic));
+            header.version = estimate_file_version;
+            header.byte_order_mark = estimate_file_byte_order_mark;
+            header.block_capacity = block_capacity;
+            file.write_at(&header, sizeof(header), 0);
+        } else {
+            file.read_at(&header, sizeof(header), 0);
+            check_estimate_file_header(header);
+            continue_last_block();
+        }
+    }
+
+    void append(const int* estimates, std::size_t num_estimates) {
+        while (num_estimates > 0) {
+            if (last_block.num_values == header.block_capacity) {
+                ++last_block_index;
+                last_block = {0, empty_block_checksum};
+            }
+            auto num_to_write{std::min<std::size_t>(num_estimates, header.block_capacity - last_block.num_values)};
+            auto block_offset{get_block_offset(header.block_capacity, last_block_index)};
+            if (last_block.num_values == 0) {
+                // A new block gets a valid, empty header before any values extend the file.
+                file.write_at(&last_block, sizeof(last_block), block_offset);
+            }
+            // Write the values before the block header that makes them visible. This only protects against a crash of
+            // the process: the kernel may write the pages to disk in any order, so after a power failure the header can
+            // count values that never reached the disk. The block checksum detects this.
+            file.write_at(estimates, num_to_write * sizeof(std::int32_t),
+                          block_offset + sizeof(EstimateBlockHeader) + last_block.num_values * sizeof(std::int32_t));
+            last_block.checksum = update_block_checksum(last_block.checksum, estimates, num_to_write);
+            last_block.num_values += static_cast<std::uint32_t>(num_to_write);
+            file.write_at(&last_block, sizeof(last_block), block_offset);
+            estimates += num_to_write;
+            num_estimates -= num_to_write;
+        }
+    }
+
+    void append(const std::vector<int>& estimates) { append(estimates.data(), estimates.size()); }
+
+    void sync() const {
+        if (::fsync(file.get()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "Cannot sync estimate file");
+        }
+    }
+
+private:
+    void continue_last_block() {
+        auto data_size{file.get_size() - sizeof(EstimateFileHeader)};
+        auto block_size{get_block_offset(header.block_capacity, 1) - sizeof(EstimateFileHeader)};
+        if (data_size == 0) {
+            return;
+        }
+        last_block_index = (data_size - 1) / block_size;
+        EstimateBlockHeader block_header{};
+        file.read_at(&block_header, sizeof(block_header), get_block_offset(header.block_capacity, last_block_index));
+        if (block_header.num_values > header.block_capacity) {
+            throw std::runtime_error("Estimate file has a block with more values than its capacity.");
+        }
+        last_block = block_header.num_values > 0 ? block_header : EstimateBlockHeader{0, empty_block_checksum};
+    }
+
+    FileDescriptor file;
+    EstimateFileHeader header{};
+    std::size_t last_block_index{0};
+    EstimateBlockHeader last_block{0, empty_block_checksum};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+struct EstimateBlock {
+    const std::int32_t* values;
+    std::size_t num_values;
+    std::uint32_t checksum;
+};
+
+class MappedEstimateFile {
+public:
+    explicit MappedEstimateFile(const std::string& path) {
+        FileDescriptor file{path, O_RDONLY};
+        mapped_size = file.get_size();
+        if (mapped_size < sizeof(EstimateFileHeader)) {
+            throw std::runtime_error("Estimate file is truncated.");
+        }
+        auto address{::mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, file.get(), 0)};
+        if (address == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "Cannot map " + path);
+        }
+        data = static_cast<const char*>(address);
+        try {
+            read_block_directory();
+        } catch (...) {
+            ::munmap(address, mapped_size);
+            throw;
+        }
+    }
+    MappedEstimateFile(const MappedEstimateFile&) = delete;
+    MappedEstimateFile& operator=(const MappedEstimateFile&) = delete;
+    ~MappedEstimateFile() { ::munmap(const_cast<char*>(data), mapped_size); }
+
+    std::size_t size() const { return num_estimates; }
+    std::size_t get_num_blocks() const { return blocks.size(); }
+    const EstimateBlock& get_block(std::size_t block_index) const { return blocks[block_index]; }
+
+    template <typename EstimateFun>
+    void for_each_estimate(EstimateFun process_estimate) const {
+        for (const auto& block : blocks) {
+            std::for_each(block.values, block.values + block.num_values, process_estimate);
+        }
+    }
+
+    std::optional<std::size_t> find_corrupt_block() const {
+        for (std::size_t i{0}; i < blocks.size(); ++i) {
+            if (update_block_checksum(empty_block_checksum, blocks[i].values, blocks[i].num_values) !=
+                blocks[i].checksum) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    // Only reads the block headers; the estimates themselves stay in the mapped file.
+    void read_block_directory() {
+        EstimateFileHeader header{};
+        std::memcpy(&header, data, sizeof(header));
+        check_estimate_file_header(header);
+        for (std::size_t block_index{0};; ++block_index) {
+            auto block_offset{get_block_offset(header.block_capacity, block_index)};
+            if (block_offset + sizeof(EstimateBlockHeader) > mapped_size) {
+                break;
+            }
+            EstimateBlockHeader block_header{};
+            std::memcpy(&block_header, data + block_offset, sizeof(block_header));
+            if (block_header.num_values == 0) {
+                // Values written without their header, e.g., before a crash, are not part of the file.
+                block_header.checksum = empty_block_checksum;
+            }
+            auto values_offset{block_offset + sizeof(EstimateBlockHeader)};
+            if (block_header.num_values > header.block_capacity ||
+                values_offset + block_header.num_values * sizeof(std::int32_t) > mapped_size) {
+                throw std::runtime_error("Estimate file is truncated.");
+            }
+            blocks.push_back({reinterpret_cast<const std::int32_t*>(data + values_offset), block_header.num_values,
+                              block_header.checksum});
+            num_estimates += block_header.num_values;
+        }
+    }
+
+    const char* data{nullptr};
+    std::size_t mapped_size{0};
+    std::vector<EstimateBlock> blocks{};
+    std::size_t num_estimates{0};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+void show_estimate_file(int num_estimates) {
+    const std::string path{"traffic_estimates.bin"};
+    std::remove(path.c_str());
+
+    TrafficEstimator estimator{};
+    for (int i{0}; i < num_estimates; ++i) {
+        estimator.add_data(i % 7, i % 5);
+    }
+    {
+        EstimateFileWriter writer{path, 1024};
+        writer.append(estimator.get_estimates());
+    }
+    {
+        // After a restart: append to the existing file, which keeps its block capacity of 1024.
+        EstimateFileWriter writer{path};
+        writer.append({10, 20, 30});
+        writer.sync();
+    }
+
+    MappedEstimateFile file{path};
+    long sum{0};
+    file.for_each_estimate([&sum](int r) { sum += r; });
+    std::cout << file.size() << " estimates in " << file.get_num_blocks() << " blocks, sum " << sum << ", "
+              << (file.find_corrupt_block() ? "corrupt" : "checksums ok") << "\n";
+    std::remove(path.c_str());
+}
+
+// %%
+show_estimate_file(10'000);
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// ### Adding Data in Batches
+//
+// - The collectors deliver samples in blocks of thousands
+// - Calling `add_data()` for each sample calls `compute_estimate()` and `save_estimate()` once per sample, and `push_back()` checks the capacity every time
+// - A batch overload of `add_data()` takes the lane counts as two arrays (pointer and size, since `std::span` is only available with C++20)
+//   - It resizes the vector for the whole batch before adding the estimates
+//   - It computes all estimates in a single loop over contiguous arrays
+
+// %% slideshow={"slide_type": "subslide"}
+class BatchTrafficEstimator {
+public:
+    void add_data(int vehicles_lane_a, int vehicles_lane_b) {
+        auto new_estimate = compute_estimate(vehicles_lane_a, vehicles_lane_b);
+        save_estimate(new_estimate);
+    }
+
+    void add_data(const int* vehicles_lane_a, const int* vehicles_lane_b, std::size_t num_samples) {
+        // `resize()` grows the capacity geometrically and zero-fills the new estimates in one pass; the loop below
+        // then writes them without checking the capacity for every sample.
+        const auto first_new_estimate{estimates.size()};
+        estimates.resize(first_new_estimate + num_samples);
+        std::transform(vehicles_lane_a, vehicles_lane_a + num_samples, vehicles_lane_b,
+                       estimates.data() + first_new_estimate, compute_estimate);
+    }
+
+    void add_data(const std::vector<int>& vehicles_lane_a, const std::vector<int>& vehicles_lane_b) {
+        if (vehicles_lane_a.size() != vehicles_lane_b.size()) {
+            throw std::invalid_argument("Both lanes need the same number of samples.");
+        }
+        add_data(vehicles_lane_a.data(), vehicles_lane_b.data(), vehicles_lane_a.size());
+    }
+
+    const std::vector<int>& get_estimates() const { return estimates; }
+
+private:
+    static int compute_estimate(int vehicles_lane_a, int vehicles_lane_b) {
+        return vehicles_lane_a + vehicles_lane_b;
+    }
+
+    void save_estimate(int new_estimate) {
+        estimates.push_back(new_estimate);
+    }
+
+    std::vector<int> estimates{};
+};
+
+// %% slideshow={"slide_type": "subslide"}
+void compare_batch_add_data(int num_blocks, int block_size) {
+    std::vector<int> lane_a(block_size);
+    std::vector<int> lane_b(block_size);
+    for (int i{0}; i < block_size; ++i) {
+        lane_a[i] = i % 7;
+        lane_b[i] = i % 5;
+    }
+
+    BatchTrafficEstimator single_estimator{};
+    auto start{std::chrono::steady_clock::now()};
+    for (int block{0}; block < num_blocks; ++block) {
+        for (int i{0}; i < block_size; ++i) {
+            single_estimator.add_data(lane_a[i], lane_b[i]);
+        }
+    }
+    std::chrono::duration<double, std::milli> single_time{std::chrono::steady_clock::now() - start};
+
+    BatchTrafficEstimator batch_estimator{};
+    start = std::chrono::steady_clock::now();
+    for (int block{0}; block < num_blocks; ++block) {
+        batch_estimator.add_data(lane_a, lane_b);
+    }
+    std::chrono::duration<double, std::milli> batch_time{std::chrono::steady_clock::now() - start};
+
+    std::cout << "One sample at a time: " << single_time.count() << "ms\n";
+    std::cout << "Whole blocks:         " << batch_time.count() << "ms ("
+              << (single_estimator.get_estimates() == batch_estimator.get_estimates() ? "same" : "different")
+              << " estimates)\n";
+}
+
+// %%
+compare_batch_add_data(100, 5'000);
+
+// %%
+compare_batch_add_data(10, 500'000);
+
+// %% [markdown] slideshow={"slide_type": "subslide"}
+// - The batch overload resizes the vector once and writes the estimates into its storage
+//   - The loop contains no capacity checks, so the compiler is free to vectorize it
+//   - Whether it does depends on the compiler and the optimization level; check the compiler's vectorization report
+// - The difference between the two versions varies with the compiler, the machine and the block size
+// - Measure with your own block sizes before relying on a batch interface for speed
+
 // %%
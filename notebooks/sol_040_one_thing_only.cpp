@@ -27,9 +27,26 @@
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 double handle_money_stuff(int i_dow, double d_spd, const char* pc_n, std::vector<double>& dv_slrs) {
@@ -72,8 +89,12 @@ std::cout << tax_1 << ", " << tax_2 << ", " << tax_3 << ", " << tax_4 << "\n";
 
 // ## Proposal for Solution
 
+bool is_valid_day_number(int day_number) {
+    return day_number >= 1 && day_number <= 7;
+}
+
 void assert_valid_day_number(int day_number) {
-    if (day_number < 1 || day_number > 7) {
+    if (!is_valid_day_number(day_number)) {
         throw std::domain_error("The value of day_number must be between 1 and 7.");
     }
 }
@@ -84,16 +105,33 @@ const std::string& compute_day_of_week_name(int day_number) {
     return day_names.at(day_number - 1);
 }
 
-double compute_tax_rate(int salary) {
-    if (salary <= 500.0) {
-        return 0.0;
-    } else if (salary <= 1000.0) {
-        return 0.05;
-    } else if (salary <= 2000.0) {
-        return 0.1;
-    } else {
-        return 0.15;
+template <typename UpperLimits, typename Salary>
+constexpr std::size_t compute_tax_bracket_index(const UpperLimits& upper_limits, Salary salary) {
+    std::size_t index{0};
+    for (const auto& upper_limit : upper_limits) {
+        index += salary > upper_limit;
+    }
+    return index;
+}
+
+struct StandardTaxBrackets {
+    static constexpr std::array<double, 3> upper_limits{500.0, 1000.0, 2000.0};
+    static constexpr std::array<double, 4> tax_rates{0.0, 0.05, 0.1, 0.15};
+};
+
+template <typename TaxBrackets>
+constexpr double lookup_tax_rate(double salary) {
+    static_assert(TaxBrackets::tax_rates.size() == TaxBrackets::upper_limits.size() + 1,
+                  "A tax schedule needs exactly one more tax rate than upper limits.");
+    double tax_rate{TaxBrackets::tax_rates[0]};
+    for (std::size_t i{0}; i < TaxBrackets::upper_limits.size(); ++i) {
+        tax_rate = salary > TaxBrackets::upper_limits[i] ? TaxBrackets::tax_rates[i + 1] : tax_rate;
     }
+    return tax_rate;
+}
+
+double compute_tax_rate(double salary) {
+    return lookup_tax_rate<StandardTaxBrackets>(salary);
 }
 
 double compute_salary_before_taxes(int day_number, double salary_per_day) {
@@ -185,7 +223,7 @@ show_compute_tax_rate();
 //
 // It may seem the repeatedly performing the `compute_salary_before_taxes()` and `compute_taxes()` might have a huge impact on performance. However, this is not necessarily the case, since C++ compilers are often very good at optimizing code and removing redundant computations. Here is the assembly generated for simplified versions of these functions (without storing the value and outputting the result and omitting the range check for `process_salary()`). The work performed by the two functions seems to be comparable.
 //
-// (However, for more complex functions the compiler may not be able to optimize away multiple calls, so it pays to profile the result.)
+// (However, for more complex functions the compiler may not be able to optimize away multiple calls, so it pays to profile the result. Once the results are also stored and printed, as in `process_salary()`, the repeated calls are no longer removed; see "Computing each value once" below.)
 
 // ```
 // handle_money_stuff(int, double, char const*):
@@ -220,22 +258,1360 @@ show_compute_tax_rate();
 //         movapd  xmm1, xmm0
 //         sub     edi, 1
 //         pxor    xmm0, xmm0
+//         movsd   xmm2, QWORD PTR .LC4[rip]
 //         cvtsi2sd        xmm0, edi
 //         mulsd   xmm0, xmm1
-//         pxor    xmm1, xmm1
-//         cvttsd2si       eax, xmm0
-//         cmp     eax, 500
-//         jle     .L39
+//         movsd   xmm1, QWORD PTR .LC1[rip]
+//         comisd  xmm0, QWORD PTR .LC5[rip]
+//         cmpltsd xmm2, xmm0
+//         andpd   xmm1, xmm2
+//         jbe     .L33
+//         movsd   xmm1, QWORD PTR .LC2[rip]
+// .L33:
+//         comisd  xmm0, QWORD PTR .LC6[rip]
+//         jbe     .L34
 //         movsd   xmm1, QWORD PTR .LC3[rip]
-//         cmp     eax, 1000
-//         jle     .L39
-//         movsd   xmm1, QWORD PTR .LC5[rip]
-//         cmp     eax, 2000
-//         jle     .L39
-//         movsd   xmm1, QWORD PTR .LC6[rip]
-// .L39:
+// .L34:
 //         mulsd   xmm0, xmm1
 //         ret
 // ```
 
+// ## Processing many employees at once
+//
+// `process_salary()` handles one employee per call. This is fine for a handful of records, but for a payroll run over millions of employees the per-call overhead dominates.
+//
+// The batch version keeps inputs and results in columns (one vector per field). It validates the whole batch up front and then runs the `compute_salary_before_taxes()` → `compute_tax_rate()` → `compute_taxes()` chain as a single loop without branches, allocations or I/O, so that the compiler can vectorize it.
+
+struct PayrollBatch {
+    std::vector<int> day_numbers{};
+    std::vector<double> salaries_per_day{};
+    std::vector<const char*> employee_names{};
+
+    std::size_t size() const { return day_numbers.size(); }
+};
+
+struct PayrollBatchResult {
+    std::vector<double> salaries_before_taxes{};
+    std::vector<double> tax_rates{};
+    std::vector<double> taxes{};
+    std::vector<double> salaries_after_taxes{};
+
+    explicit PayrollBatchResult(std::size_t size)
+        : salaries_before_taxes(size), tax_rates(size), taxes(size), salaries_after_taxes(size) {}
+
+    std::size_t size() const { return taxes.size(); }
+};
+
+void assert_consistent_batch(const PayrollBatch& batch) {
+    if (batch.salaries_per_day.size() != batch.size() || batch.employee_names.size() != batch.size()) {
+        throw std::invalid_argument("All columns of a payroll batch must have the same length.");
+    }
+}
+
+void assert_valid_day_numbers(const std::vector<int>& day_numbers) {
+    if (!std::all_of(cbegin(day_numbers), cend(day_numbers), is_valid_day_number)) {
+        throw std::domain_error("The value of day_number must be between 1 and 7.");
+    }
+}
+
+// ### Tax brackets as data
+//
+// An `if` chain in `compute_tax_rate()` would put branches into the loop. Instead, `compute_tax_rate()` treats the brackets as data: a list of upper limits (each bracket includes its limit) and one more tax rate than limits for everything above the last limit.
+//
+// The index of the bracket for a salary is the number of limits the salary exceeds; counting them needs no branches. Since the standard brackets never change, they are a type, `StandardTaxBrackets`, with `constexpr` tables, and `lookup_tax_rate()` is instantiated for it, so that the compiler sees the limits as constants. Instead of indexing the table of rates, which would need a gather instruction in a vectorized loop, `lookup_tax_rate()` compares the salary with each limit and selects the next rate if the salary exceeds it. This compiles to a few compares and blends, so the loop vectorizes with plain SSE2.
+
+static_assert(lookup_tax_rate<StandardTaxBrackets>(500.0) == 0.0);
+static_assert(lookup_tax_rate<StandardTaxBrackets>(500.01) == 0.05);
+static_assert(lookup_tax_rate<StandardTaxBrackets>(2000.0) == 0.1);
+
+// ### The batch loop
+
+// Fills the rows from `first_row` up to (but excluding) `last_row` of a preallocated result. The day numbers in
+// these rows must already have been validated.
+template <typename TaxRateFun>
+void compute_payroll_rows(const PayrollBatch& batch, std::size_t first_row, std::size_t last_row,
+                          TaxRateFun compute_tax_rate, PayrollBatchResult& result) {
+    const int* day_numbers{batch.day_numbers.data()};
+    const double* salaries_per_day{batch.salaries_per_day.data()};
+    double* salaries_before_taxes{result.salaries_before_taxes.data()};
+    double* tax_rates{result.tax_rates.data()};
+    double* taxes{result.taxes.data()};
+    double* salaries_after_taxes{result.salaries_after_taxes.data()};
+
+    for (std::size_t i{first_row}; i < last_row; ++i) {
+        const double salary_before_taxes{(day_numbers[i] - 1) * salaries_per_day[i]};
+        const double tax_rate{compute_tax_rate(salary_before_taxes)};
+        const double tax{salary_before_taxes * tax_rate};
+        salaries_before_taxes[i] = salary_before_taxes;
+        tax_rates[i] = tax_rate;
+        taxes[i] = tax;
+        salaries_after_taxes[i] = salary_before_taxes - tax;
+    }
+}
+
+template <typename TaxRateFun>
+PayrollBatchResult compute_payroll_batch(const PayrollBatch& batch, TaxRateFun compute_tax_rate) {
+    assert_consistent_batch(batch);
+    assert_valid_day_numbers(batch.day_numbers);
+
+    PayrollBatchResult result(batch.size());
+    compute_payroll_rows(batch, 0, batch.size(), compute_tax_rate, result);
+    return result;
+}
+
+PayrollBatchResult compute_payroll_batch(const PayrollBatch& batch) {
+    return compute_payroll_batch(batch, lookup_tax_rate<StandardTaxBrackets>);
+}
+
+void show_compute_payroll_batch() {
+    PayrollBatch batch{{3, 5, 6, 6}, {240.0, 240.0, 260.0, 800.0}, {"Joe", "Jack", "Jill", "Jane"}};
+    auto result = compute_payroll_batch(batch);
+    for (std::size_t i{0}; i < result.size(); ++i) {
+        std::cout << batch.employee_names[i] << ": gross $" << result.salaries_before_taxes[i]
+                  << ", taxes $" << result.taxes[i] << ", net $" << result.salaries_after_taxes[i] << "\n";
+    }
+}
+
+#ifdef __CLING__
+show_compute_payroll_batch();
+#endif
+
+// ## Computing each value once
+//
+// `process_salary()` calls `compute_salary_after_taxes()` and `compute_taxes()`, and `print_salary()` calls both of them again. Therefore every record runs `compute_salary_before_taxes()` and `assert_valid_day_number()` five or more times, and since the results are printed the compiler cannot remove the duplicate work.
+//
+// We can keep the functions small and still compute each value only once by collecting the results in a `PayrollResult` that is passed to the storing and printing steps.
+
+struct PayrollResult {
+    double salary_before_taxes{};
+    double tax_rate{};
+    double taxes{};
+    double salary_after_taxes{};
+    std::string_view day_name{};
+};
+
+PayrollResult compute_payroll_result(int day_number, double salary_per_day) {
+    const auto salary_before_taxes = compute_salary_before_taxes(day_number, salary_per_day);
+    const auto tax_rate = compute_tax_rate(salary_before_taxes);
+    const auto taxes = salary_before_taxes * tax_rate;
+    return {salary_before_taxes, tax_rate, taxes, salary_before_taxes - taxes, compute_day_of_week_name(day_number)};
+}
+
+void print_salary(const PayrollResult& result, const char* employee_name) {
+    std::cout << employee_name << " worked till " << result.day_name
+              << " and earned $" << result.salary_after_taxes << " this week.\n";
+    std::cout << "  " << "Their taxes were $" << result.taxes << ".";
+    std::cout << std::endl;
+}
+
+double process_salary_single_pass(int day_number, double salary_per_day, const char* employee_name,
+                                  std::vector<double>& all_salaries) {
+    const auto result = compute_payroll_result(day_number, salary_per_day);
+    store_salary(result.salary_after_taxes, all_salaries);
+    print_salary(result, employee_name);
+    return result.taxes;
+}
+
+#ifdef __CLING__
+std::vector<double> all_salaries{};
+double tax_1{process_salary_single_pass(3, 240.0, "Joe", all_salaries)};
+double tax_2{process_salary_single_pass(5, 240.0, "Jack", all_salaries)};
+double tax_3{process_salary_single_pass(6, 260.0, "Jill", all_salaries)};
+double tax_4{process_salary_single_pass(6, 800.0, "Jane", all_salaries)};
+#endif
+
+#ifdef __CLING__
+std::cout << tax_1 << ", " << tax_2 << ", " << tax_3 << ", " << tax_4 << "\n";
+#endif
+
+// ### Measuring the difference
+//
+// To compare the two versions we discard everything written to `std::cout` while the benchmark runs, so that we measure the computation and not the terminal.
+
+class DiscardingBuffer : public std::streambuf {
+public:
+    DiscardingBuffer() { reset(); }
+
+protected:
+    int overflow(int ch) override {
+        reset();
+        return traits_type::not_eof(ch);
+    }
+
+private:
+    void reset() { setp(buffer.data(), buffer.data() + buffer.size()); }
+
+    std::array<char, 4096> buffer{};
+};
+
+class SilencedStdout {
+public:
+    SilencedStdout() : original_buffer{std::cout.rdbuf(&discarding_buffer)} {}
+    ~SilencedStdout() { std::cout.rdbuf(original_buffer); }
+    SilencedStdout(const SilencedStdout&) = delete;
+    SilencedStdout& operator=(const SilencedStdout&) = delete;
+
+private:
+    DiscardingBuffer discarding_buffer{};
+    std::streambuf* original_buffer;
+};
+
+template <typename ProcessSalaryFun>
+double measure_nanoseconds_per_record(ProcessSalaryFun process, int num_records) {
+    std::vector<double> all_salaries{};
+    all_salaries.reserve(num_records);
+    double total_taxes{0.0};
+    SilencedStdout silenced_stdout{};
+    const auto start = std::chrono::steady_clock::now();
+    for (int i{0}; i < num_records; ++i) {
+        total_taxes += process(2 + i % 6, 100.0 + i % 500, "Employee", all_salaries);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    // Storing the total in a `volatile` keeps the compiler from discarding the calculations we want to time.
+    [[maybe_unused]] static volatile double timed_total_taxes{};
+    timed_total_taxes = total_taxes;
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_records;
+}
+
+void benchmark_process_salary(int num_records = 1'000'000) {
+    const auto original_ns = measure_nanoseconds_per_record(process_salary, num_records);
+    const auto single_pass_ns = measure_nanoseconds_per_record(process_salary_single_pass, num_records);
+    std::cout << "process_salary():             " << original_ns << " ns/record\n";
+    std::cout << "process_salary_single_pass(): " << single_pass_ns << " ns/record\n";
+}
+
+#ifdef __CLING__
+benchmark_process_salary();
+#endif
+
+// Don't be surprised if the difference is small: formatting the two output lines with `std::cout` costs much more than the repeated arithmetic. This is why it pays to measure before optimizing.
+
+// ## Tax brackets loaded at runtime
+//
+// `StandardTaxBrackets` is fixed at compile time. If the brackets differ between jurisdictions, or change without a new release of the program, we load them at runtime and look them up with the same `compute_tax_bracket_index()`. (Looking up the rate in a runtime table needs a branch or a gather, so with a `TaxSchedule` the batch loop is not vectorized.)
+
+class TaxSchedule {
+public:
+    TaxSchedule(std::vector<double> upper_limits, std::vector<double> tax_rates)
+        : upper_limits{std::move(upper_limits)}, tax_rates{std::move(tax_rates)} {
+        assert_valid_schedule();
+    }
+
+    double compute_tax_rate(double salary) const {
+        return tax_rates[compute_tax_bracket_index(upper_limits, salary)];
+    }
+
+private:
+    void assert_valid_schedule() const {
+        if (tax_rates.size() != upper_limits.size() + 1) {
+            throw std::invalid_argument("A tax schedule needs exactly one more tax rate than upper limits.");
+        }
+        if (std::adjacent_find(cbegin(upper_limits), cend(upper_limits), std::greater_equal<>{}) !=
+            cend(upper_limits)) {
+            throw std::invalid_argument("The upper limits of a tax schedule must be strictly increasing.");
+        }
+    }
+
+    std::vector<double> upper_limits;
+    std::vector<double> tax_rates;
+};
+
+// Reads a schedule with one bracket per line: the tax rate followed by the upper limit of the bracket. The last line contains only the tax rate for all salaries above the last limit. Blank lines are skipped; any other line that is not a tax rate, optionally followed by a limit, is rejected.
+
+TaxSchedule read_tax_schedule(std::istream& input) {
+    std::vector<double> upper_limits{};
+    std::vector<double> tax_rates{};
+    std::string line{};
+    while (std::getline(input, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        if (tax_rates.size() > upper_limits.size()) {
+            throw std::invalid_argument("Only the last line of a tax schedule may omit the upper limit.");
+        }
+        std::istringstream line_stream{line};
+        double tax_rate{};
+        if (!(line_stream >> tax_rate)) {
+            throw std::invalid_argument("Invalid line in tax schedule: '" + line + "'");
+        }
+        tax_rates.push_back(tax_rate);
+        double upper_limit{};
+        if (line_stream >> upper_limit) {
+            upper_limits.push_back(upper_limit);
+        } else {
+            line_stream.clear();
+        }
+        if (!(line_stream >> std::ws).eof()) {
+            throw std::invalid_argument("Invalid line in tax schedule: '" + line + "'");
+        }
+    }
+    return TaxSchedule{std::move(upper_limits), std::move(tax_rates)};
+}
+
+void show_tax_schedules() {
+    std::istringstream schedule_text{"0.0 500\n0.05 1000\n\n0.1 2000\n0.15\n"};
+    const auto schedule = read_tax_schedule(schedule_text);
+    for (double salary : {0.0, 499.99, 500.0, 500.01, 1000.0, 1000.01, 2000.0, 2000.01, 3000.0}) {
+        std::cout << "Salary: " << salary << ", tax rates: " << schedule.compute_tax_rate(salary) << " (runtime table), "
+                  << lookup_tax_rate<StandardTaxBrackets>(salary) << " (compile-time table)\n";
+    }
+    PayrollBatch batch{{3, 5, 6, 6}, {240.0, 240.0, 260.0, 800.0}, {"Joe", "Jack", "Jill", "Jane"}};
+    auto result = compute_payroll_batch(batch, [&schedule](double salary) { return schedule.compute_tax_rate(salary); });
+    for (std::size_t i{0}; i < result.size(); ++i) {
+        std::cout << batch.employee_names[i] << ": taxes $" << result.taxes[i] << "\n";
+    }
+}
+
+#ifdef __CLING__
+show_tax_schedules();
+#endif
+
+void show_invalid_tax_schedules() {
+    for (const char* text : {"0.0 500\nfive percent 1000\n0.15\n", "0.0 500\n0.05 1000 2000\n0.15\n",
+                             "0.0 500\n0.05\n0.1 2000\n0.15\n", "0.0 500\n0.05 1000\n",
+                             "0.0 1000\n0.05 500\n0.15\n"}) {
+        std::istringstream schedule_text{text};
+        try {
+            read_tax_schedule(schedule_text);
+            std::cout << "Accepted an invalid schedule!\n";
+        }
+        catch (const std::invalid_argument& err) {
+            std::cout << "Caught expected error: " << err.what() << "\n";
+        }
+    }
+}
+
+#ifdef __CLING__
+show_invalid_tax_schedules();
+#endif
+
+// ## Writing reports in large chunks
+//
+// `print_salary()` writes directly to `std::cout` and ends every record with `std::endl`, which flushes the stream. For millions of records the program spends most of its time in write system calls.
+//
+// A `ReportSink` collects the report lines in a large, preallocated buffer. When the buffer is full it is handed to a background thread that writes it to the output stream (`std::cout` or a file) in one call, while the next lines go into a second buffer. The output stream is only flushed at the end of a batch or when `flush()` is called explicitly. `flush()` also checks the stream and throws if anything could not be written, so that a full disk does not silently truncate the report.
+
+class ReportSink {
+public:
+    explicit ReportSink(std::ostream& output, std::size_t buffer_capacity = 1 << 20)
+        : output{output}, buffer_capacity{buffer_capacity} {
+        filling_buffer.reserve(buffer_capacity);
+        writing_buffer.reserve(buffer_capacity);
+        writer = std::thread{[this]() { write_handed_over_buffers(); }};
+    }
+
+    // Does not report errors; call `flush()` first to find out whether the whole report was written.
+    ~ReportSink() {
+        write_pending_text();
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            is_stopping = true;
+        }
+        work_available.notify_one();
+        writer.join();
+    }
+
+    ReportSink(const ReportSink&) = delete;
+    ReportSink& operator=(const ReportSink&) = delete;
+
+    void append(std::string_view text) {
+        if (filling_buffer.size() + text.size() > buffer_capacity) {
+            hand_over_filling_buffer();
+        }
+        filling_buffer.append(text);
+    }
+
+    // Throws `std::runtime_error` if the output stream failed, e.g., because the disk is full.
+    void flush() {
+        write_pending_text();
+        if (!output) {
+            throw std::runtime_error("The report could not be written completely.");
+        }
+    }
+
+private:
+    void write_pending_text() {
+        hand_over_filling_buffer();
+        std::unique_lock<std::mutex> lock{mutex};
+        writer_idle.wait(lock, [this]() { return !has_handed_over_buffer; });
+        output.flush();
+    }
+
+    void hand_over_filling_buffer() {
+        if (filling_buffer.empty()) {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            writer_idle.wait(lock, [this]() { return !has_handed_over_buffer; });
+            std::swap(filling_buffer, writing_buffer);
+            has_handed_over_buffer = true;
+        }
+        work_available.notify_one();
+    }
+
+    void write_handed_over_buffers() {
+        std::unique_lock<std::mutex> lock{mutex};
+        while (true) {
+            work_available.wait(lock, [this]() { return has_handed_over_buffer || is_stopping; });
+            if (!has_handed_over_buffer) {
+                return;
+            }
+            lock.unlock();
+            output.write(writing_buffer.data(), static_cast<std::streamsize>(writing_buffer.size()));
+            writing_buffer.clear();
+            lock.lock();
+            has_handed_over_buffer = false;
+            writer_idle.notify_all();
+        }
+    }
+
+    std::ostream& output;
+    const std::size_t buffer_capacity;
+    std::string filling_buffer{};
+    std::string writing_buffer{};
+    std::mutex mutex{};
+    std::condition_variable work_available{};
+    std::condition_variable writer_idle{};
+    bool has_handed_over_buffer{false};
+    bool is_stopping{false};
+    std::thread writer{};
+};
+
+// The report text is the same as before; only its destination changes.
+
+std::string format_salary_report(const PayrollResult& result, const char* employee_name) {
+    std::ostringstream report{};
+    report << employee_name << " worked till " << result.day_name
+           << " and earned $" << result.salary_after_taxes << " this week.\n";
+    report << "  " << "Their taxes were $" << result.taxes << ".\n";
+    return report.str();
+}
+
+// ### Formatting money without streams
+//
+// Once the output is buffered, formatting the report lines through `std::ostringstream` becomes the most expensive step: every line allocates a string and every amount goes through the locale-aware stream machinery.
+//
+// Amounts of money have a fixed number of decimal places, so we can round them to whole cents and format the integer parts with `std::to_chars`, writing directly into a buffer provided by the caller. Like the stream output, the formatter omits a fractional part of zero and trailing zeros.
+//
+// Note that this changes the report text for some amounts: `operator<<` prints six significant digits, so it shows fractions of a cent (`$30.8642`) and drops cents from amounts of $10,000 and more (`$12750.5`). The new formatter always prints whole cents (`$30.86`, `$12750.52`), which is what a payroll report should show anyway. All reports below use the new formatter, so the format of the amounts in one report is always the same.
+
+class CharBufferWriter {
+public:
+    CharBufferWriter(char* first, char* last) : position{first}, last{last} {}
+
+    void append(std::string_view text) {
+        if (has_overflowed() || static_cast<std::size_t>(last - position) < text.size()) {
+            position = nullptr;
+            return;
+        }
+        position = std::copy(cbegin(text), cend(text), position);
+    }
+
+    void append_money(double amount) { append_money_in_cents(std::llround(amount * 100.0)); }
+
+    void append_money_in_cents(long long amount_in_cents) {
+        if (amount_in_cents < 0) {
+            append("-");
+        }
+        const unsigned long long abs_amount_in_cents{
+            amount_in_cents < 0 ? 0ULL - amount_in_cents : 0ULL + amount_in_cents};
+        append_integer(abs_amount_in_cents / 100);
+        append_cents(static_cast<int>(abs_amount_in_cents % 100));
+    }
+
+    bool has_overflowed() const { return position == nullptr; }
+
+    std::to_chars_result result() const {
+        if (has_overflowed()) {
+            return {last, std::errc::value_too_large};
+        }
+        return {position, std::errc{}};
+    }
+
+private:
+    void append_integer(unsigned long long value) {
+        if (has_overflowed()) {
+            return;
+        }
+        const auto [end, error] = std::to_chars(position, last, value);
+        position = error == std::errc{} ? end : nullptr;
+    }
+
+    void append_cents(int cents) {
+        if (cents == 0) {
+            return;
+        }
+        const char digits[]{'.', static_cast<char>('0' + cents / 10), static_cast<char>('0' + cents % 10)};
+        append({digits, cents % 10 == 0 ? 2u : 3u});
+    }
+
+    char* position;
+    char* last;
+};
+
+std::to_chars_result format_salary_report(char* first, char* last, const PayrollResult& result,
+                                          const char* employee_name) {
+    CharBufferWriter writer{first, last};
+    writer.append(employee_name);
+    writer.append(" worked till ");
+    writer.append(result.day_name);
+    writer.append(" and earned $");
+    writer.append_money(result.salary_after_taxes);
+    writer.append(" this week.\n  Their taxes were $");
+    writer.append_money(result.taxes);
+    writer.append(".\n");
+    return writer.result();
+}
+
+// For reports that do not fit into a buffer on the stack: the same formatting into a buffer on the heap.
+
+std::string format_long_salary_report(const PayrollResult& result, const char* employee_name) {
+    std::string report(std::string_view{employee_name}.size() + 128, '\0');
+    while (true) {
+        const auto [end, error] = format_salary_report(report.data(), report.data() + report.size(), result,
+                                                       employee_name);
+        if (error == std::errc{}) {
+            report.resize(static_cast<std::size_t>(end - report.data()));
+            return report;
+        }
+        report.resize(2 * report.size());
+    }
+}
+
+void show_format_salary_report() {
+    for (double amount : {48.0, 912.5, 0.07, 30.8642, 12750.52}) {
+        const PayrollResult result{amount, 0.0, amount, amount, "Fri"};
+        std::array<char, 128> line_buffer;
+        const auto [end, error] = format_salary_report(line_buffer.data(), line_buffer.data() + line_buffer.size(),
+                                                       result, "Joe");
+        const std::string_view to_chars_text(line_buffer.data(), end - line_buffer.data());
+        const auto stream_text = format_salary_report(result, "Joe");
+        if (to_chars_text == stream_text) {
+            std::cout << "same:     " << to_chars_text;
+        } else {
+            std::cout << "to_chars: " << to_chars_text << "stream:   " << stream_text;
+        }
+    }
+}
+
+#ifdef __CLING__
+show_format_salary_report();
+#endif
+
+// `print_salary()` formats each report into a buffer on the stack. Only if an unusually long name does not fit do we fall back to a buffer on the heap.
+
+void print_salary(const PayrollResult& result, const char* employee_name, ReportSink& sink) {
+    std::array<char, 256> line_buffer;
+    const auto [end, error] = format_salary_report(line_buffer.data(), line_buffer.data() + line_buffer.size(),
+                                                   result, employee_name);
+    if (error == std::errc{}) {
+        sink.append({line_buffer.data(), static_cast<std::size_t>(end - line_buffer.data())});
+    } else {
+        sink.append(format_long_salary_report(result, employee_name));
+    }
+}
+
+PayrollResult get_payroll_result(const PayrollBatch& batch, const PayrollBatchResult& result, std::size_t index) {
+    return {result.salaries_before_taxes[index], result.tax_rates[index], result.taxes[index],
+            result.salaries_after_taxes[index], compute_day_of_week_name(batch.day_numbers[index])};
+}
+
+void print_payroll_batch(const PayrollBatch& batch, const PayrollBatchResult& result, ReportSink& sink) {
+    for (std::size_t i{0}; i < result.size(); ++i) {
+        print_salary(get_payroll_result(batch, result, i), batch.employee_names[i], sink);
+    }
+    sink.flush();
+}
+
+void show_report_sink() {
+    PayrollBatch batch{{3, 5, 6, 6}, {240.0, 240.0, 260.0, 800.0}, {"Joe", "Jack", "Jill", "Jane"}};
+    ReportSink sink{std::cout};
+    print_payroll_batch(batch, compute_payroll_batch(batch), sink);
+}
+
+#ifdef __CLING__
+show_report_sink();
+#endif
+
+// Writing a large report to a file works the same way:
+
+void write_payroll_report(const PayrollBatch& batch, const char* file_name) {
+    std::ofstream report_file{file_name, std::ios::binary};
+    if (!report_file) {
+        throw std::runtime_error(std::string{"Cannot open the report file "} + file_name + ".");
+    }
+    ReportSink sink{report_file};
+    print_payroll_batch(batch, compute_payroll_batch(batch), sink);
+}
+
+// ## Rejecting invalid records without exceptions
+//
+// `compute_payroll_batch()` throws if a single day number in the batch is invalid, and the per-record functions throw for every invalid record. When an upstream feed delivers batches with many bad day codes, we would rather process the valid records and report all rejected records together.
+//
+// `check_day_numbers()` checks the whole column in one branch-free pass that produces a flag per row. Only if some flags are not set does it collect the indices of the invalid rows.
+
+struct DayNumberCheck {
+    std::vector<unsigned char> is_valid{};
+    std::vector<std::size_t> invalid_rows{};
+
+    bool are_all_valid() const { return invalid_rows.empty(); }
+};
+
+DayNumberCheck check_day_numbers(const std::vector<int>& day_numbers) {
+    DayNumberCheck check{std::vector<unsigned char>(day_numbers.size())};
+    // Stores through an `unsigned char*` may alias anything, so the loop must only use local pointers and
+    // sizes; otherwise the compiler reloads them in every iteration and does not vectorize the loop.
+    const int* days{day_numbers.data()};
+    unsigned char* is_valid_flags{check.is_valid.data()};
+    const std::size_t num_days{day_numbers.size()};
+    std::size_t num_valid{0};
+    for (std::size_t i{0}; i < num_days; ++i) {
+        const bool is_valid{is_valid_day_number(days[i])};
+        is_valid_flags[i] = is_valid;
+        num_valid += is_valid;
+    }
+    if (num_valid < day_numbers.size()) {
+        check.invalid_rows.reserve(day_numbers.size() - num_valid);
+        for (std::size_t i{0}; i < day_numbers.size(); ++i) {
+            if (!check.is_valid[i]) {
+                check.invalid_rows.push_back(i);
+            }
+        }
+    }
+    return check;
+}
+
+PayrollBatch select_rows(const PayrollBatch& batch, const std::vector<unsigned char>& is_selected) {
+    const auto num_selected = static_cast<std::size_t>(std::count(cbegin(is_selected), cend(is_selected), 1));
+    PayrollBatch selected_rows{};
+    selected_rows.day_numbers.reserve(num_selected);
+    selected_rows.salaries_per_day.reserve(num_selected);
+    selected_rows.employee_names.reserve(num_selected);
+    for (std::size_t i{0}; i < batch.size(); ++i) {
+        if (is_selected[i]) {
+            selected_rows.day_numbers.push_back(batch.day_numbers[i]);
+            selected_rows.salaries_per_day.push_back(batch.salaries_per_day[i]);
+            selected_rows.employee_names.push_back(batch.employee_names[i]);
+        }
+    }
+    return selected_rows;
+}
+
+// The error report lists only the first few rejected rows, since a broken feed may contain millions of them.
 
+std::string describe_rejected_rows(const PayrollBatch& batch, const std::vector<std::size_t>& rejected_rows,
+                                   std::size_t max_rows_listed = 10) {
+    std::ostringstream report{};
+    report << rejected_rows.size() << " of " << batch.size()
+           << " records were rejected because their day number is not between 1 and 7.\n";
+    const auto num_listed = std::min(rejected_rows.size(), max_rows_listed);
+    for (std::size_t i{0}; i < num_listed; ++i) {
+        const auto row = rejected_rows[i];
+        report << "  Row " << row << " (" << batch.employee_names[row] << "): day " << batch.day_numbers[row] << "\n";
+    }
+    if (num_listed < rejected_rows.size()) {
+        report << "  ... and " << rejected_rows.size() - num_listed << " more.\n";
+    }
+    return report.str();
+}
+
+struct CheckedPayrollBatchResult {
+    PayrollBatch valid_rows;
+    PayrollBatchResult result;
+    std::vector<std::size_t> rejected_rows;
+};
+
+// Takes the batch by value so that a caller that no longer needs it can move it into the result when all rows are
+// valid. The rows have been checked here, so they go straight to `compute_payroll_rows()`.
+CheckedPayrollBatchResult compute_valid_payroll_batch(PayrollBatch batch) {
+    assert_consistent_batch(batch);
+    auto check = check_day_numbers(batch.day_numbers);
+    auto valid_rows = check.are_all_valid() ? std::move(batch) : select_rows(batch, check.is_valid);
+    PayrollBatchResult result(valid_rows.size());
+    compute_payroll_rows(valid_rows, 0, valid_rows.size(), lookup_tax_rate<StandardTaxBrackets>, result);
+    return {std::move(valid_rows), std::move(result), std::move(check.invalid_rows)};
+}
+
+void show_compute_valid_payroll_batch() {
+    PayrollBatch batch{{3, 0, 6, 9, 6, 8},
+                       {240.0, 240.0, 260.0, 100.0, 800.0, 120.0},
+                       {"Joe", "Jack", "Jill", "Jim", "Jane", "Jean"}};
+    const auto checked = compute_valid_payroll_batch(batch);
+    for (std::size_t i{0}; i < checked.result.size(); ++i) {
+        std::cout << checked.valid_rows.employee_names[i] << ": net $" << checked.result.salaries_after_taxes[i] << "\n";
+    }
+    if (!checked.rejected_rows.empty()) {
+        std::cout << describe_rejected_rows(batch, checked.rejected_rows);
+    }
+}
+
+#ifdef __CLING__
+show_compute_valid_payroll_batch();
+#endif
+
+// ## Storing millions of salaries
+//
+// `store_salary()` appends to a `std::vector<double>`. Whenever the vector runs out of capacity it allocates a larger block and copies all salaries stored so far; for hundreds of megabytes of salaries this causes noticeable latency spikes.
+//
+// A `SalaryLedger` stores the salaries in fixed-size chunks. Appending never moves existing salaries, so their addresses remain stable, and each append takes constant time. Readers can iterate over all salaries or access them chunk by chunk without copying them.
+
+struct SalaryLedgerChunk {
+    const double* salaries;
+    std::size_t size;
+};
+
+class SalaryLedger {
+public:
+    static constexpr std::size_t chunk_capacity{8192};
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = double;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const double*;
+        using reference = const double&;
+
+        const_iterator() = default;
+        const_iterator(const SalaryLedger* ledger, std::size_t index) : ledger{ledger}, index{index} {}
+
+        reference operator*() const { return (*ledger)[index]; }
+        const_iterator& operator++() {
+            ++index;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto previous = *this;
+            ++index;
+            return previous;
+        }
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+    private:
+        const SalaryLedger* ledger{};
+        std::size_t index{};
+    };
+
+    void append(double salary) {
+        if (size_in_last_chunk == chunk_capacity || chunks.empty()) {
+            add_chunk();
+        }
+        chunks.back()[size_in_last_chunk++] = salary;
+    }
+
+    void append(const double* salaries, std::size_t num_salaries) {
+        while (num_salaries > 0) {
+            if (size_in_last_chunk == chunk_capacity || chunks.empty()) {
+                add_chunk();
+            }
+            const auto num_copied = std::min(num_salaries, chunk_capacity - size_in_last_chunk);
+            std::copy(salaries, salaries + num_copied, chunks.back().get() + size_in_last_chunk);
+            size_in_last_chunk += num_copied;
+            salaries += num_copied;
+            num_salaries -= num_copied;
+        }
+    }
+
+    std::size_t size() const {
+        return chunks.empty() ? 0 : (chunks.size() - 1) * chunk_capacity + size_in_last_chunk;
+    }
+
+    const double& operator[](std::size_t index) const {
+        return chunks[index / chunk_capacity][index % chunk_capacity];
+    }
+
+    std::size_t num_chunks() const { return chunks.size(); }
+
+    SalaryLedgerChunk get_chunk(std::size_t chunk_index) const {
+        const bool is_last_chunk{chunk_index + 1 == chunks.size()};
+        return {chunks[chunk_index].get(), is_last_chunk ? size_in_last_chunk : chunk_capacity};
+    }
+
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, size()}; }
+
+private:
+    void add_chunk() {
+        chunks.push_back(std::unique_ptr<double[]>{new double[chunk_capacity]});
+        size_in_last_chunk = 0;
+    }
+
+    std::vector<std::unique_ptr<double[]>> chunks{};
+    std::size_t size_in_last_chunk{0};
+};
+
+void store_salary(double salary, SalaryLedger& all_salaries) {
+    all_salaries.append(salary);
+}
+
+void store_salaries(const PayrollBatchResult& result, SalaryLedger& all_salaries) {
+    all_salaries.append(result.salaries_after_taxes.data(), result.size());
+}
+
+double compute_total_salaries(const SalaryLedger& all_salaries) {
+    double total{0.0};
+    for (std::size_t i{0}; i < all_salaries.num_chunks(); ++i) {
+        const auto chunk = all_salaries.get_chunk(i);
+        total = std::accumulate(chunk.salaries, chunk.salaries + chunk.size, total);
+    }
+    return total;
+}
+
+void show_salary_ledger() {
+    PayrollBatch batch{{3, 5, 6, 6}, {240.0, 240.0, 260.0, 800.0}, {"Joe", "Jack", "Jill", "Jane"}};
+    SalaryLedger all_salaries{};
+    store_salaries(compute_payroll_batch(batch), all_salaries);
+    store_salary(compute_payroll_result(2, 300.0).salary_after_taxes, all_salaries);
+    for (double salary : all_salaries) {
+        std::cout << salary << "\n";
+    }
+    std::cout << "Total: $" << compute_total_salaries(all_salaries) << "\n";
+}
+
+#ifdef __CLING__
+show_salary_ledger();
+#endif
+
+// ## Running the payroll on all cores
+//
+// All functions so far run on a single thread. To use all cores we split a batch into shards of a fixed size and let several workers process them. Each worker owns its own salary ledger and report buffer, so the workers never wait for each other while they compute, store and format.
+//
+// Shards are distributed with work stealing: every worker starts with a contiguous range of shards in its own queue and, once that queue is empty, takes shards from the back of other workers' queues. The workers are started once in a `PayrollWorkerPool` and wait for the next run, so a run does not pay for starting threads.
+
+class ShardQueues {
+public:
+    ShardQueues(std::size_t num_shards, std::size_t num_workers) : queues(num_workers) {
+        for (std::size_t shard_index{0}; shard_index < num_shards; ++shard_index) {
+            queues[shard_index * num_workers / num_shards].shards.push_back(shard_index);
+        }
+    }
+
+    std::optional<std::size_t> take_shard(std::size_t worker_index) {
+        if (auto shard_index = take_own_shard(queues[worker_index])) {
+            return shard_index;
+        }
+        for (std::size_t offset{1}; offset < queues.size(); ++offset) {
+            if (auto shard_index = steal_shard(queues[(worker_index + offset) % queues.size()])) {
+                return shard_index;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex{};
+        std::deque<std::size_t> shards{};
+    };
+
+    static std::optional<std::size_t> take_own_shard(WorkerQueue& queue) {
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        if (queue.shards.empty()) {
+            return std::nullopt;
+        }
+        const auto shard_index = queue.shards.front();
+        queue.shards.pop_front();
+        return shard_index;
+    }
+
+    static std::optional<std::size_t> steal_shard(WorkerQueue& queue) {
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        if (queue.shards.empty()) {
+            return std::nullopt;
+        }
+        const auto shard_index = queue.shards.back();
+        queue.shards.pop_back();
+        return shard_index;
+    }
+
+    std::vector<WorkerQueue> queues;
+};
+
+class PayrollWorkerPool {
+public:
+    explicit PayrollWorkerPool(std::size_t num_workers = std::thread::hardware_concurrency()) {
+        num_workers = std::max<std::size_t>(num_workers, 1);
+        for (std::size_t worker_index{0}; worker_index < num_workers; ++worker_index) {
+            workers.emplace_back([this, worker_index]() { process_runs(worker_index); });
+        }
+    }
+
+    ~PayrollWorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            is_stopping = true;
+        }
+        work_available.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    PayrollWorkerPool(const PayrollWorkerPool&) = delete;
+    PayrollWorkerPool& operator=(const PayrollWorkerPool&) = delete;
+
+    std::size_t size() const { return workers.size(); }
+
+    // Calls `process_shard(worker_index, shard_index)` for every shard on the pool's workers and returns once all
+    // shards are processed.
+    void process_shards(std::size_t num_shards, const std::function<void(std::size_t, std::size_t)>& process_shard) {
+        std::lock_guard<std::mutex> run_lock{run_mutex};
+        ShardQueues shard_queues{num_shards, workers.size()};
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            current_shard_queues = &shard_queues;
+            current_process_shard = &process_shard;
+            num_busy_workers = workers.size();
+            ++run_number;
+        }
+        work_available.notify_all();
+        std::unique_lock<std::mutex> lock{mutex};
+        run_finished.wait(lock, [this]() { return num_busy_workers == 0; });
+    }
+
+private:
+    void process_runs(std::size_t worker_index) {
+        std::size_t last_run_number{0};
+        std::unique_lock<std::mutex> lock{mutex};
+        while (true) {
+            work_available.wait(lock, [&]() { return is_stopping || run_number != last_run_number; });
+            if (is_stopping) {
+                return;
+            }
+            last_run_number = run_number;
+            auto& shard_queues = *current_shard_queues;
+            const auto& process_shard = *current_process_shard;
+            lock.unlock();
+            while (auto shard_index = shard_queues.take_shard(worker_index)) {
+                process_shard(worker_index, *shard_index);
+            }
+            lock.lock();
+            if (--num_busy_workers == 0) {
+                run_finished.notify_one();
+            }
+        }
+    }
+
+    std::mutex run_mutex{};
+    std::mutex mutex{};
+    std::condition_variable work_available{};
+    std::condition_variable run_finished{};
+    std::size_t run_number{0};
+    std::size_t num_busy_workers{0};
+    bool is_stopping{false};
+    ShardQueues* current_shard_queues{nullptr};
+    const std::function<void(std::size_t, std::size_t)>* current_process_shard{nullptr};
+    std::vector<std::thread> workers{};
+};
+
+// Floating-point addition is not associative, so the totals depend on the order in which they are added up. To get exactly the same totals no matter how many workers there are and which worker processed which shard, each shard computes its own totals and the shard totals are then added in shard order. The shard size is fixed, so `compute_payroll_totals()` can add up the results of a serial run in the same way and gets bit-for-bit the same totals. (A plain running sum over all records does not: it rounds differently and usually differs in the last bits.)
+
+struct PayrollTotals {
+    double salaries_before_taxes{0.0};
+    double taxes{0.0};
+    double salaries_after_taxes{0.0};
+
+    void add(const PayrollTotals& other) {
+        salaries_before_taxes += other.salaries_before_taxes;
+        taxes += other.taxes;
+        salaries_after_taxes += other.salaries_after_taxes;
+    }
+};
+
+struct ProcessedShard {
+    std::size_t shard_index{};
+    std::size_t first_salary_in_ledger{};
+    std::size_t report_begin{};
+    std::size_t report_end{};
+};
+
+// Everything one worker produces. The workers' outputs are stored side by side in a vector, so they are aligned to
+// keep one worker's appends from invalidating the cache line of the next.
+struct alignas(64) PayrollWorkerOutput {
+    SalaryLedger salaries{};
+    std::string reports{};
+    std::vector<ProcessedShard> processed_shards{};
+};
+
+struct ParallelPayrollRun {
+    PayrollBatchResult result;
+    PayrollTotals totals;
+    std::vector<PayrollWorkerOutput> worker_outputs;
+};
+
+constexpr std::size_t payroll_shard_size{16384};
+
+PayrollTotals compute_shard_totals(const PayrollBatchResult& result, std::size_t first_row, std::size_t last_row) {
+    PayrollTotals totals{};
+    for (std::size_t i{first_row}; i < last_row; ++i) {
+        totals.salaries_before_taxes += result.salaries_before_taxes[i];
+        totals.taxes += result.taxes[i];
+        totals.salaries_after_taxes += result.salaries_after_taxes[i];
+    }
+    return totals;
+}
+
+void format_salary_reports(const PayrollBatch& batch, const PayrollBatchResult& result, std::size_t first_row,
+                           std::size_t last_row, std::string& reports) {
+    std::array<char, 256> line_buffer;
+    for (std::size_t i{first_row}; i < last_row; ++i) {
+        const auto payroll_result = get_payroll_result(batch, result, i);
+        const auto [end, error] = format_salary_report(line_buffer.data(), line_buffer.data() + line_buffer.size(),
+                                                       payroll_result, batch.employee_names[i]);
+        if (error == std::errc{}) {
+            reports.append(line_buffer.data(), end);
+        } else {
+            reports.append(format_long_salary_report(payroll_result, batch.employee_names[i]));
+        }
+    }
+}
+
+void process_payroll_shard(const PayrollBatch& batch, std::size_t shard_index, PayrollBatchResult& result,
+                           PayrollTotals& shard_totals, PayrollWorkerOutput& worker_output) {
+    const auto first_row = shard_index * payroll_shard_size;
+    const auto last_row = std::min(first_row + payroll_shard_size, batch.size());
+    compute_payroll_rows(batch, first_row, last_row, lookup_tax_rate<StandardTaxBrackets>, result);
+    shard_totals = compute_shard_totals(result, first_row, last_row);
+
+    ProcessedShard processed_shard{shard_index, worker_output.salaries.size(), worker_output.reports.size()};
+    worker_output.salaries.append(result.salaries_after_taxes.data() + first_row, last_row - first_row);
+    format_salary_reports(batch, result, first_row, last_row, worker_output.reports);
+    processed_shard.report_end = worker_output.reports.size();
+    worker_output.processed_shards.push_back(processed_shard);
+}
+
+std::size_t compute_num_payroll_shards(std::size_t num_records) {
+    return (num_records + payroll_shard_size - 1) / payroll_shard_size;
+}
+
+// Adds up the results of a serial run shard by shard, exactly like `run_payroll_in_parallel()`.
+PayrollTotals compute_payroll_totals(const PayrollBatchResult& result) {
+    PayrollTotals totals{};
+    for (std::size_t shard_index{0}; shard_index < compute_num_payroll_shards(result.size()); ++shard_index) {
+        const auto first_row = shard_index * payroll_shard_size;
+        totals.add(compute_shard_totals(result, first_row, std::min(first_row + payroll_shard_size, result.size())));
+    }
+    return totals;
+}
+
+ParallelPayrollRun run_payroll_in_parallel(const PayrollBatch& batch, PayrollWorkerPool& workers) {
+    assert_consistent_batch(batch);
+    assert_valid_day_numbers(batch.day_numbers);
+
+    const auto num_shards = compute_num_payroll_shards(batch.size());
+    ParallelPayrollRun run{PayrollBatchResult(batch.size()), {}, std::vector<PayrollWorkerOutput>(workers.size())};
+    std::vector<PayrollTotals> shard_totals(num_shards);
+    workers.process_shards(num_shards, [&](std::size_t worker_index, std::size_t shard_index) {
+        process_payroll_shard(batch, shard_index, run.result, shard_totals[shard_index],
+                              run.worker_outputs[worker_index]);
+    });
+
+    for (const auto& totals : shard_totals) {
+        run.totals.add(totals);
+    }
+    return run;
+}
+
+// The workers' outputs can be written out in the original order of the records, independent of the way the shards were distributed.
+
+template <typename ShardFun>
+void for_each_processed_shard_in_order(const ParallelPayrollRun& run, ShardFun process_shard) {
+    std::vector<std::pair<const ProcessedShard*, const PayrollWorkerOutput*>> shards{};
+    for (const auto& worker_output : run.worker_outputs) {
+        for (const auto& processed_shard : worker_output.processed_shards) {
+            shards.emplace_back(&processed_shard, &worker_output);
+        }
+    }
+    std::sort(begin(shards), end(shards),
+              [](const auto& lhs, const auto& rhs) { return lhs.first->shard_index < rhs.first->shard_index; });
+    for (const auto& [processed_shard, worker_output] : shards) {
+        process_shard(*processed_shard, *worker_output);
+    }
+}
+
+void write_reports_in_order(const ParallelPayrollRun& run, ReportSink& sink) {
+    for_each_processed_shard_in_order(run, [&sink](const ProcessedShard& shard, const PayrollWorkerOutput& output) {
+        sink.append(std::string_view{output.reports}.substr(shard.report_begin, shard.report_end - shard.report_begin));
+    });
+    sink.flush();
+}
+
+// Appends the salaries from the workers' ledgers to `all_salaries` in the original order of the records.
+void store_salaries_in_order(const ParallelPayrollRun& run, SalaryLedger& all_salaries) {
+    for_each_processed_shard_in_order(run, [&run, &all_salaries](const ProcessedShard& shard,
+                                                                 const PayrollWorkerOutput& output) {
+        const auto first_row = shard.shard_index * payroll_shard_size;
+        auto num_salaries = std::min(payroll_shard_size, run.result.size() - first_row);
+        auto index = shard.first_salary_in_ledger;
+        while (num_salaries > 0) {
+            const auto chunk = output.salaries.get_chunk(index / SalaryLedger::chunk_capacity);
+            const auto offset = index % SalaryLedger::chunk_capacity;
+            const auto num_copied = std::min(num_salaries, chunk.size - offset);
+            all_salaries.append(chunk.salaries + offset, num_copied);
+            index += num_copied;
+            num_salaries -= num_copied;
+        }
+    });
+}
+
+void show_run_payroll_in_parallel(std::size_t num_records = 1'000'000) {
+    PayrollBatch batch{};
+    for (std::size_t i{0}; i < num_records; ++i) {
+        batch.day_numbers.push_back(static_cast<int>(2 + i % 6));
+        batch.salaries_per_day.push_back(100.0 + 0.37 * (i % 1000));
+        batch.employee_names.push_back("Employee");
+    }
+    const auto serial_result = compute_payroll_batch(batch);
+    std::cout << "Serial:    total taxes $" << std::hexfloat << compute_payroll_totals(serial_result).taxes
+              << " (running sum $" << std::accumulate(cbegin(serial_result.taxes), cend(serial_result.taxes), 0.0)
+              << ")\n" << std::defaultfloat;
+    for (std::size_t num_workers : {1, 2, 4, 8}) {
+        PayrollWorkerPool workers{num_workers};
+        const auto start = std::chrono::steady_clock::now();
+        const auto run = run_payroll_in_parallel(batch, workers);
+        const auto end = std::chrono::steady_clock::now();
+        SalaryLedger salaries_in_order{};
+        store_salaries_in_order(run, salaries_in_order);
+        const bool are_salaries_in_order{std::equal(salaries_in_order.begin(), salaries_in_order.end(),
+                                                    cbegin(serial_result.salaries_after_taxes),
+                                                    cend(serial_result.salaries_after_taxes))};
+        std::cout << num_workers << " workers: total taxes $" << std::hexfloat << run.totals.taxes << std::defaultfloat
+                  << " in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms, salaries "
+                  << (are_salaries_in_order ? "in record order" : "out of order") << "\n";
+    }
+}
+
+#ifdef __CLING__
+show_run_payroll_in_parallel();
+#endif
+
+// ## Computing with whole cents
+//
+// The payroll uses `double` for all amounts, while the `Money` type in the lecture stores whole cents. Doubles cannot represent most amounts of cents exactly, and as we saw above, their sums depend on the order of the additions. With whole cents every intermediate result is exact, so totals can be added up in any order (and on any number of threads). (This is not a speed optimization: rounding the taxes divides 64-bit integers by 10,000, which current x86 compilers do not vectorize, so the batch loop stays scalar.)
+//
+// Tax rates are expressed in basis points (hundredths of a percent), and taxes are rounded to the nearest cent, with half a cent rounded up.
+
+struct Money {
+    long amount_in_cents{};
+};
+
+Money operator+(Money lhs, Money rhs) { return Money{lhs.amount_in_cents + rhs.amount_in_cents}; }
+Money operator-(Money lhs, Money rhs) { return Money{lhs.amount_in_cents - rhs.amount_in_cents}; }
+Money operator*(long factor, Money money) { return Money{factor * money.amount_in_cents}; }
+Money& operator+=(Money& lhs, Money rhs) { return lhs = lhs + rhs; }
+bool operator==(Money lhs, Money rhs) { return lhs.amount_in_cents == rhs.amount_in_cents; }
+bool operator!=(Money lhs, Money rhs) { return !(lhs == rhs); }
+
+Money dollars_to_money(double amount_in_dollars) { return Money{std::lround(amount_in_dollars * 100.0)}; }
+
+std::ostream& operator<<(std::ostream& os, Money money) {
+    std::array<char, 32> buffer;
+    CharBufferWriter writer{buffer.data(), buffer.data() + buffer.size()};
+    writer.append_money_in_cents(money.amount_in_cents);
+    return os << std::string_view(buffer.data(), writer.result().ptr - buffer.data());
+}
+
+constexpr long basis_points_per_unit{10'000};
+
+// Both tables are derived from `StandardTaxBrackets`, rounded to whole cents and basis points.
+template <std::size_t size>
+constexpr std::array<long, size> scale_and_round(const std::array<double, size>& values, double factor) {
+    std::array<long, size> result{};
+    for (std::size_t i{0}; i < size; ++i) {
+        result[i] = static_cast<long>(values[i] * factor + 0.5);
+    }
+    return result;
+}
+
+constexpr auto tax_bracket_upper_limits_in_cents{scale_and_round(StandardTaxBrackets::upper_limits, 100.0)};
+constexpr auto tax_rates_in_basis_points{scale_and_round(StandardTaxBrackets::tax_rates, basis_points_per_unit)};
+
+static_assert(tax_bracket_upper_limits_in_cents[0] == 50'000);
+static_assert(tax_rates_in_basis_points[3] == 1'500);
+
+long compute_tax_rate_in_basis_points(Money salary) {
+    return tax_rates_in_basis_points[compute_tax_bracket_index(tax_bracket_upper_limits_in_cents,
+                                                               salary.amount_in_cents)];
+}
+
+Money apply_tax_rate(Money salary, long tax_rate_in_basis_points) {
+    return Money{(salary.amount_in_cents * tax_rate_in_basis_points + basis_points_per_unit / 2) /
+                 basis_points_per_unit};
+}
+
+Money compute_salary_before_taxes(int day_number, Money salary_per_day) {
+    assert_valid_day_number(day_number);
+    return (day_number - 1) * salary_per_day;
+}
+
+Money compute_taxes(Money salary_before_taxes) {
+    return apply_tax_rate(salary_before_taxes, compute_tax_rate_in_basis_points(salary_before_taxes));
+}
+
+Money compute_salary_after_taxes(int day_number, Money salary_per_day) {
+    const auto salary_before_taxes = compute_salary_before_taxes(day_number, salary_per_day);
+    return salary_before_taxes - compute_taxes(salary_before_taxes);
+}
+
+// The batch versions work on columns of `Money`. Since `Money` only wraps a `long`, a `std::vector<Money>` has the same layout as a `std::vector<long>`.
+
+struct PayrollBatchResultInCents {
+    std::vector<Money> salaries_before_taxes{};
+    std::vector<Money> taxes{};
+    std::vector<Money> salaries_after_taxes{};
+
+    explicit PayrollBatchResultInCents(std::size_t size)
+        : salaries_before_taxes(size), taxes(size), salaries_after_taxes(size) {}
+
+    std::size_t size() const { return taxes.size(); }
+};
+
+std::vector<Money> dollars_to_money(const std::vector<double>& amounts_in_dollars) {
+    std::vector<Money> amounts(amounts_in_dollars.size());
+    std::transform(cbegin(amounts_in_dollars), cend(amounts_in_dollars), begin(amounts),
+                   [](double amount) { return dollars_to_money(amount); });
+    return amounts;
+}
+
+PayrollBatchResultInCents compute_payroll_batch_in_cents(const std::vector<int>& day_numbers,
+                                                         const std::vector<Money>& salaries_per_day) {
+    if (salaries_per_day.size() != day_numbers.size()) {
+        throw std::invalid_argument("All columns of a payroll batch must have the same length.");
+    }
+    assert_valid_day_numbers(day_numbers);
+
+    PayrollBatchResultInCents result(day_numbers.size());
+    for (std::size_t i{0}; i < day_numbers.size(); ++i) {
+        const Money salary_before_taxes{(day_numbers[i] - 1) * salaries_per_day[i]};
+        const Money taxes{compute_taxes(salary_before_taxes)};
+        result.salaries_before_taxes[i] = salary_before_taxes;
+        result.taxes[i] = taxes;
+        result.salaries_after_taxes[i] = salary_before_taxes - taxes;
+    }
+    return result;
+}
+
+PayrollBatchResultInCents compute_payroll_batch_in_cents(const PayrollBatch& batch) {
+    assert_consistent_batch(batch);
+    return compute_payroll_batch_in_cents(batch.day_numbers, dollars_to_money(batch.salaries_per_day));
+}
+
+Money compute_total(const Money* first, const Money* last) {
+    long total_in_cents{0};
+    for (; first != last; ++first) {
+        total_in_cents += first->amount_in_cents;
+    }
+    return Money{total_in_cents};
+}
+
+Money compute_total(const std::vector<Money>& amounts) {
+    return compute_total(amounts.data(), amounts.data() + amounts.size());
+}
+
+// Adding up the shards of a batch in reverse order gives exactly the same total as adding up the whole batch.
+
+Money compute_total_in_reverse_shard_order(const std::vector<Money>& amounts) {
+    Money total{};
+    for (auto shard_begin = amounts.size(); shard_begin > 0;) {
+        const auto shard_end = shard_begin;
+        shard_begin = shard_begin >= payroll_shard_size ? shard_begin - payroll_shard_size : 0;
+        total += compute_total(amounts.data() + shard_begin, amounts.data() + shard_end);
+    }
+    return total;
+}
+
+void show_compute_payroll_batch_in_cents() {
+    PayrollBatch batch{{3, 5, 6, 6}, {240.0, 240.0, 260.0, 800.0}, {"Joe", "Jack", "Jill", "Jane"}};
+    const auto result = compute_payroll_batch_in_cents(batch);
+    for (std::size_t i{0}; i < result.size(); ++i) {
+        std::cout << batch.employee_names[i] << ": gross $" << result.salaries_before_taxes[i] << ", taxes $"
+                  << result.taxes[i] << ", net $" << result.salaries_after_taxes[i] << "\n";
+    }
+
+    std::vector<int> day_numbers(1'000'000);
+    std::vector<Money> salaries_per_day(day_numbers.size());
+    for (std::size_t i{0}; i < day_numbers.size(); ++i) {
+        day_numbers[i] = static_cast<int>(2 + i % 6);
+        salaries_per_day[i] = Money{10'000 + 37 * static_cast<long>(i % 1000)};
+    }
+    const auto large_result = compute_payroll_batch_in_cents(day_numbers, salaries_per_day);
+    std::cout << "Total taxes: $" << compute_total(large_result.taxes) << " (in order), $"
+              << compute_total_in_reverse_shard_order(large_result.taxes) << " (reverse shard order)\n";
+}
+
+#ifdef __CLING__
+show_compute_payroll_batch_in_cents();
+#endif
+
+// ## Updating the week-to-date payroll every day
+//
+// If we post the payroll every day, `compute_salary_before_taxes()` recomputes the salary for the week so far from scratch, and the taxes are computed again from the whole amount.
+//
+// `WeekToDatePayroll` keeps the running state for one employee and advances it one day at a time. The taxes before rounding, `salary * rate`, are a whole number of cent-basis-points, so they can be updated by adding `salary_per_day * rate` every day without any rounding error. The bracket and its rate are only looked up again when the salary crosses the upper limit of the current bracket.
+
+class WeekToDatePayroll {
+public:
+    explicit WeekToDatePayroll(Money salary_per_day) : salary_per_day{salary_per_day} {}
+
+    void advance_day() {
+        assert_valid_day_number(day_number + 1);
+        ++day_number;
+        salary_before_taxes += salary_per_day;
+        if (salary_before_taxes.amount_in_cents > tax_bracket_upper_limit_in_cents) {
+            update_tax_bracket();
+        } else {
+            unrounded_taxes += tax_rate_in_basis_points * salary_per_day.amount_in_cents;
+        }
+    }
+
+    int get_day_number() const { return day_number; }
+    Money get_salary_before_taxes() const { return salary_before_taxes; }
+    Money get_taxes() const { return Money{(unrounded_taxes + basis_points_per_unit / 2) / basis_points_per_unit}; }
+    Money get_salary_after_taxes() const { return salary_before_taxes - get_taxes(); }
+
+private:
+    void update_tax_bracket() {
+        const auto bracket_index = compute_tax_bracket_index(tax_bracket_upper_limits_in_cents,
+                                                             salary_before_taxes.amount_in_cents);
+        tax_rate_in_basis_points = tax_rates_in_basis_points[bracket_index];
+        tax_bracket_upper_limit_in_cents = bracket_index < tax_bracket_upper_limits_in_cents.size()
+                                               ? tax_bracket_upper_limits_in_cents[bracket_index]
+                                               : std::numeric_limits<long>::max();
+        unrounded_taxes = tax_rate_in_basis_points * salary_before_taxes.amount_in_cents;
+    }
+
+    // We count Sunday as 1 and pay only from Monday on, so on day 1 nothing has been earned yet.
+    int day_number{1};
+    Money salary_per_day;
+    Money salary_before_taxes{};
+    long tax_rate_in_basis_points{tax_rates_in_basis_points[0]};
+    long tax_bracket_upper_limit_in_cents{tax_bracket_upper_limits_in_cents[0]};
+    long unrounded_taxes{0};
+};
+
+void advance_day(std::vector<WeekToDatePayroll>& payrolls) {
+    for (auto& payroll : payrolls) {
+        payroll.advance_day();
+    }
+}
+
+void show_week_to_date_payroll() {
+    const std::vector<Money> salaries_per_day{Money{24'000}, Money{26'001}, Money{80'000}};
+    std::vector<WeekToDatePayroll> payrolls(cbegin(salaries_per_day), cend(salaries_per_day));
+    for (int day_number{2}; day_number <= 7; ++day_number) {
+        advance_day(payrolls);
+        std::cout << compute_day_of_week_name(day_number) << ":";
+        for (std::size_t i{0}; i < payrolls.size(); ++i) {
+            const auto taxes_from_scratch = compute_taxes(compute_salary_before_taxes(day_number, salaries_per_day[i]));
+            std::cout << "  taxes $" << payrolls[i].get_taxes()
+                      << (payrolls[i].get_taxes() == taxes_from_scratch ? " (same)" : " (different!)");
+        }
+        std::cout << "\n";
+    }
+}
+
+#ifdef __CLING__
+show_week_to_date_payroll();
+#endif